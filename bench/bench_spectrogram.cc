@@ -0,0 +1,423 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Micro-benchmarks for the waterfall pipeline, from the sink's work()
+ * down to rendering the image, on synthetic input.
+ *
+ * Every result is printed as one CSV line:
+ *   benchmark,param1,param2,value,unit
+ *
+ * Arguments name the benchmarks to run (e.g. "work render"); without any
+ * all of them run. Only the work benchmark builds the sink's widget and
+ * needs a (virtual) display, e.g. xvfb-run; without it Qt is started
+ * with the GUI disabled, which is enough to paint into QImages.
+ */
+
+#include "vector_averager.h"
+#include <spectrogram/WaterfallVectorGlobalData.h>
+#include <spectrogram/WaterfallVectorUpdateEvents.h>
+#include <spectrogram/composite_mode.h>
+#include <spectrogram/plot_waterfall.h>
+#include <spectrogram/spectrogram_types.h>
+#include <spectrogram/waterfall_vector_sink_f.h>
+#include <gnuradio/high_res_timer.h>
+#include <volk/volk.h>
+#include <qwt_scale_map.h>
+#include <QApplication>
+#include <QImage>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace gr::spectrogram;
+
+static double elapsed(gr::high_res_timer_type start)
+{
+  return double(gr::high_res_timer_now() - start) / gr::high_res_timer_tps();
+}
+
+static float *make_buffer(unsigned int n)
+{
+  float *buf = (float *)volk_malloc(n * sizeof(float), volk_get_alignment());
+  for (unsigned int i = 0; i < n; i++)
+    buf[i] = -100.0f + 50.0f * (rand() / float(RAND_MAX));
+  return buf;
+}
+
+/*
+ * Exponential averaging as done by work(): one state buffer per
+ * connection, folding a block of input vectors per call.
+ */
+static void bench_averaging(unsigned int vecsize, int nconnections)
+{
+  const unsigned int nvecs = 16;
+  const int iterations =
+      std::max(8, int(64 * 1024 * 1024 / (vecsize * nconnections * nvecs)));
+
+  vector_averager averager(vecsize);
+  std::vector<float *> in, avg;
+  for (int n = 0; n < nconnections; n++)
+  {
+    in.push_back(make_buffer(vecsize * nvecs));
+    avg.push_back(make_buffer(vecsize));
+  }
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+    for (int n = 0; n < nconnections; n++)
+      averager.exponential(avg[n], in[n], nvecs, 0.2f);
+  double secs = elapsed(start);
+
+  printf("averaging,%u,%d,%.0f,bins/s\n",
+         vecsize, nconnections, double(iterations) * nvecs * vecsize * nconnections / secs);
+
+  for (int n = 0; n < nconnections; n++)
+  {
+    volk_free(in[n]);
+    volk_free(avg[n]);
+  }
+}
+
+/*
+ * Turning a full canvas of history into intensities, once with a
+ * value() call per pixel as QwtPlotSpectrogram::renderTile() does and
+ * once a line at a time from the tables built by initRaster().
+ */
+static void bench_raster(int width, int height)
+{
+  const unsigned int vecsize = 4096;
+  const unsigned int history = 1024;
+  const int iterations = std::max(4, int(64 * 1024 * 1024 / (width * height)));
+
+  WaterfallVectorData data(0.0, 1.0, vecsize, history);
+  float *row = make_buffer(vecsize);
+  for (unsigned int r = 0; r < history; r++)
+    data.addVecData(row, vecsize, 0);
+  volk_free(row);
+
+#if QWT_VERSION < 0x060000
+  const QwtDoubleRect area(0.0, 0.0, 1.0, history);
+#else
+  const QRectF area(0.0, 0.0, 1.0, history);
+#endif
+  const double xstep = area.width() / width;
+  const double ystep = area.height() / height;
+  std::vector<float> line(width);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+    for (int y = 0; y < height; y++)
+    {
+      const double ty = area.bottom() - y * ystep;
+      for (int x = 0; x < width; x++)
+        line[x] = data.value(area.left() + x * xstep, ty);
+    }
+  double secs = elapsed(start);
+  printf("raster_value,%d,%d,%.0f,pixels/s\n",
+         width, height, double(iterations) * width * height / secs);
+
+  start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+  {
+    data.initRaster(area, QSize(width, height));
+    const std::vector<int64_t> &rows = data.getRasterRows();
+    for (int y = 0; y < height; y++)
+      data.getRasterLine(rows[y], &line[0]);
+    data.discardRaster();
+  }
+  secs = elapsed(start);
+  printf("raster_table,%d,%d,%.0f,pixels/s\n",
+         width, height, double(iterations) * width * height / secs);
+}
+
+/*
+ * The sink's work() as the scheduler calls it, with the default
+ * exponential averaging and update period. Only work() is timed; posted
+ * rows are handed to the GUI between calls so the row pool never runs
+ * dry and every emitted row is copied as in a live flowgraph.
+ */
+static void bench_work(unsigned int vecsize, int nconnections)
+{
+  const unsigned int nvecs = 64;
+  const int iterations =
+      std::max(16, int(256 * 1024 * 1024 / (vecsize * nconnections * nvecs)));
+
+  waterfall_vector_sink_f::sptr sink =
+      waterfall_vector_sink_f::make(vecsize, 0.0, 1.0, "bench", nconnections);
+
+  std::vector<float *> in;
+  gr_vector_const_void_star inputs;
+  gr_vector_void_star outputs;
+  for (int n = 0; n < nconnections; n++)
+  {
+    in.push_back(make_buffer(vecsize * nvecs));
+    inputs.push_back(in[n]);
+  }
+
+  double secs = 0;
+  for (int i = 0; i < iterations; i++)
+  {
+    gr::high_res_timer_type start = gr::high_res_timer_now();
+    sink->work(nvecs, inputs, outputs);
+    secs += elapsed(start);
+    QCoreApplication::processEvents();
+  }
+
+  printf("work,%u,%d,%.0f,vectors/s\n",
+         vecsize, nconnections, double(iterations) * nvecs / secs);
+
+  for (int n = 0; n < nconnections; n++)
+    volk_free(in[n]);
+}
+
+/*
+ * Allocating and freeing the update event the sink posts, which holds a
+ * reference to the row pool.
+ */
+static void bench_event()
+{
+  const int iterations = 1000000;
+  WaterfallRowPool::sptr pool(new WaterfallRowPool(16, 1, 1024));
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+    delete new WaterfallUpdateEvent(pool);
+  double secs = elapsed(start);
+
+  printf("event,0,0,%.1f,ns/event\n", secs * 1e9 / iterations);
+}
+
+/*
+ * Appending rows to a full history of each length and storage type; the
+ * ring buffer should make this independent of the history length.
+ */
+static void bench_history(unsigned int history, int storage)
+{
+  const unsigned int vecsize = 1024;
+  const int iterations = 20000;
+
+  WaterfallVectorData data(0.0, 1.0, vecsize, history, storage);
+  float *row = make_buffer(vecsize);
+  for (unsigned int r = 0; r < history; r++)
+    data.addVecData(row, vecsize, 0);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+    data.addVecData(row, vecsize, 0);
+  double secs = elapsed(start);
+
+  printf("add_vec_data,%u,%d,%.0f,rows/s\n", history, storage, iterations / secs);
+  volk_free(row);
+}
+
+#if QWT_VERSION >= 0x060000
+static QwtColorMap *make_color_map(int type)
+{
+  switch (type)
+  {
+  case INTENSITY_COLOR_MAP_TYPE_WHITE_HOT:
+    return new ColorMap_WhiteHot();
+  case INTENSITY_COLOR_MAP_TYPE_BLACK_HOT:
+    return new ColorMap_BlackHot();
+  case INTENSITY_COLOR_MAP_TYPE_INCANDESCENT:
+    return new ColorMap_Incandescent();
+  case INTENSITY_COLOR_MAP_TYPE_USER_DEFINED:
+    return new ColorMap_UserDefined(QColor("black"), QColor("white"));
+  case INTENSITY_COLOR_MAP_TYPE_SUNSET:
+    return new ColorMap_Sunset();
+  case INTENSITY_COLOR_MAP_TYPE_COOL:
+    return new ColorMap_Cool();
+  default:
+    return new ColorMap_MultiColor();
+  }
+}
+
+/*
+ * WaterfallSpectrogram::renderImage() for a canvas and colour map, both
+ * as a full redraw and as the usual scroll by one new row.
+ */
+static void bench_render(int width, int height, int color_map)
+{
+  const unsigned int vecsize = 4096;
+  const unsigned int history = 1024;
+  const int iterations = std::max(4, int(16 * 1024 * 1024 / (width * height)));
+
+  // The spectrogram owns its data
+  WaterfallVectorData *data = new WaterfallVectorData(0.0, 1.0, vecsize, history);
+  data->setInterval(Qt::ZAxis, QwtInterval(-120.0, -40.0));
+  float *row = make_buffer(vecsize);
+  for (unsigned int r = 0; r < history; r++)
+    data->addVecData(row, vecsize, 0);
+
+  WaterfallSpectrogram item(data);
+  item.setColorMap(make_color_map(color_map));
+
+  const QRectF area(0.0, 0.0, 1.0, history);
+  const QSize size(width, height);
+  QwtScaleMap xMap, yMap;
+  xMap.setScaleInterval(area.left(), area.right());
+  xMap.setPaintInterval(0, width);
+  yMap.setScaleInterval(area.top(), area.bottom());
+  yMap.setPaintInterval(height, 0);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+  {
+    item.invalidateImage();
+    item.renderImage(xMap, yMap, area, size);
+  }
+  double secs = elapsed(start);
+  printf("render_full,%dx%d,%d,%.3f,ms/frame\n",
+         width, height, color_map, secs * 1e3 / iterations);
+
+  item.renderImage(xMap, yMap, area, size);
+  start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+  {
+    data->addVecData(row, vecsize, 0);
+    item.renderImage(xMap, yMap, area, size);
+  }
+  secs = elapsed(start);
+  printf("render_scroll,%dx%d,%d,%.3f,ms/frame\n",
+         width, height, color_map, secs * 1e3 / iterations);
+
+  volk_free(row);
+}
+
+/*
+ * Full redraws of nconnections overlaid inputs on a 1920x1080 canvas:
+ * one image per input (COMPOSITE_NONE, without the cost of blending
+ * them when drawn) or all of them composited into one.
+ */
+static void bench_composite(int nconnections, int mode)
+{
+  const unsigned int vecsize = 4096;
+  const unsigned int history = 1024;
+  const int width = 1920;
+  const int height = 1080;
+  const int iterations = 16;
+
+  float *row = make_buffer(vecsize);
+  std::vector<WaterfallSpectrogram *> items;
+  for (int i = 0; i < nconnections; i++)
+  {
+    WaterfallVectorData *data = new WaterfallVectorData(0.0, 1.0, vecsize, history);
+    data->setInterval(Qt::ZAxis, QwtInterval(-120.0, -40.0));
+    for (unsigned int r = 0; r < history; r++)
+      data->addVecData(row, vecsize, 0);
+    items.push_back(new WaterfallSpectrogram(data));
+    items.back()->setColorMap(make_color_map(i % (INTENSITY_COLOR_MAP_TYPE_COOL + 1)));
+    items.back()->setAlpha(i == 0 ? 255 : 255 / nconnections);
+  }
+  if (mode != COMPOSITE_NONE)
+    items[0]->setComposite(
+        mode, std::vector<WaterfallSpectrogram *>(items.begin() + 1, items.end()));
+  const size_t drawn = (mode == COMPOSITE_NONE) ? items.size() : 1;
+
+  const QRectF area(0.0, 0.0, 1.0, history);
+  const QSize size(width, height);
+  QwtScaleMap xMap, yMap;
+  xMap.setScaleInterval(area.left(), area.right());
+  xMap.setPaintInterval(0, width);
+  yMap.setScaleInterval(area.top(), area.bottom());
+  yMap.setPaintInterval(height, 0);
+
+  gr::high_res_timer_type start = gr::high_res_timer_now();
+  for (int i = 0; i < iterations; i++)
+  {
+    for (size_t j = 0; j < drawn; j++)
+    {
+      items[j]->invalidateImage();
+      items[j]->renderImage(xMap, yMap, area, size);
+    }
+  }
+  double secs = elapsed(start);
+  printf("composite,%d,%d,%.3f,ms/frame\n", nconnections, mode, secs * 1e3 / iterations);
+
+  for (size_t i = 0; i < items.size(); i++)
+    delete items[i];
+  volk_free(row);
+}
+#endif
+
+static bool selected(int argc, char **argv, const char *name)
+{
+  if (argc < 2)
+    return true;
+  for (int i = 1; i < argc; i++)
+    if (strcmp(argv[i], name) == 0)
+      return true;
+  return false;
+}
+
+int main(int argc, char **argv)
+{
+  const int connections[] = {1, 2, 4, 10};
+  const int canvas[][2] = {{320, 240}, {800, 600}, {1920, 1080}, {3840, 2160}};
+
+  // The sink's widget needs a display; the data and render benchmarks
+  // only paint into QImages and run without one
+  const bool gui = selected(argc, argv, "work");
+  int qt_argc = 1;
+  QApplication app(qt_argc, argv, gui);
+
+  printf("benchmark,param1,param2,value,unit\n");
+
+  if (selected(argc, argv, "averaging"))
+    for (unsigned int vecsize = 1024; vecsize <= 65536; vecsize *= 4)
+      for (size_t c = 0; c < sizeof(connections) / sizeof(connections[0]); c++)
+        bench_averaging(vecsize, connections[c]);
+
+  if (selected(argc, argv, "work"))
+    for (unsigned int vecsize = 1024; vecsize <= 65536; vecsize *= 8)
+      for (size_t c = 0; c < sizeof(connections) / sizeof(connections[0]); c++)
+        bench_work(vecsize, connections[c]);
+
+  if (selected(argc, argv, "event"))
+    bench_event();
+
+  if (selected(argc, argv, "history"))
+    for (unsigned int history = 256; history <= 32768; history *= 8)
+      for (int storage = STORAGE_FLOAT; storage <= STORAGE_UINT8; storage++)
+        bench_history(history, storage);
+
+  if (selected(argc, argv, "raster"))
+    for (size_t c = 0; c < sizeof(canvas) / sizeof(canvas[0]); c++)
+      bench_raster(canvas[c][0], canvas[c][1]);
+
+#if QWT_VERSION >= 0x060000
+  if (selected(argc, argv, "render"))
+    for (size_t c = 0; c < sizeof(canvas) / sizeof(canvas[0]); c++)
+      for (int map = INTENSITY_COLOR_MAP_TYPE_MULTI_COLOR;
+           map <= INTENSITY_COLOR_MAP_TYPE_COOL;
+           map++)
+        bench_render(canvas[c][0], canvas[c][1], map);
+
+  if (selected(argc, argv, "composite"))
+    for (size_t c = 0; c < sizeof(connections) / sizeof(connections[0]); c++)
+      for (int mode = COMPOSITE_NONE; mode <= COMPOSITE_MAX; mode++)
+        bench_composite(connections[c], mode);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef WATERFALL_METRICS_H
+#define WATERFALL_METRICS_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/metric_type.h>
+#include <gnuradio/high_res_timer.h>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+
+/*!
+ * \brief Counters and latency histograms shared by a waterfall sink and
+ * its display.
+ * \ingroup spectrogram_blk
+ *
+ * \details
+ * Counters are indexed by gr::spectrogram::counter_t and latencies by
+ * gr::spectrogram::latency_t. Every update is a single relaxed atomic
+ * add, so the sink thread, the GUI thread and the render threads record
+ * without locking and readers may poll at any time. Latencies go into
+ * buckets a quarter octave (about 19%) wide from 1 us up to over an
+ * hour; percentiles are reported as the upper edge of their bucket.
+ */
+class SPECTROGRAM_API WaterfallMetrics
+{
+public:
+    typedef boost::shared_ptr<WaterfallMetrics> sptr;
+
+    static const unsigned int NUM_BUCKETS = 128;
+
+    WaterfallMetrics();
+
+    void count(const int counter, const uint64_t n = 1);
+    uint64_t counter(const int counter) const;
+    // Rows posted by the sink that the display has not taken in yet
+    uint64_t queueDepth() const;
+
+    void record(const int latency, const double seconds);
+    // Records the time elapsed since \p start
+    void recordSince(const int latency, const gr::high_res_timer_type start);
+    uint64_t samples(const int latency) const;
+    double mean(const int latency) const;
+    double percentile(const int latency, const double p) const;
+
+    void reset();
+
+private:
+    boost::atomic<uint64_t> d_counters[gr::spectrogram::NUM_COUNTERS];
+    boost::atomic<uint64_t> d_buckets[gr::spectrogram::NUM_LATENCIES][NUM_BUCKETS];
+    boost::atomic<uint64_t> d_samples[gr::spectrogram::NUM_LATENCIES];
+    boost::atomic<uint64_t> d_total_ns[gr::spectrogram::NUM_LATENCIES];
+};
+
+#endif /* WATERFALL_METRICS_H */
@@ -0,0 +1,97 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef WATERFALL_RENDER_WORKER_H
+#define WATERFALL_RENDER_WORKER_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/WaterfallMetrics.h>
+#include <gnuradio/high_res_timer.h>
+#include <QMutex>
+#include <QObject>
+#include <stdint.h>
+
+class QEvent;
+class QTimerEvent;
+class WaterfallVectorDisplayPlot;
+
+/*!
+ * \brief Adds posted rows to a waterfall and renders its frames on a
+ * thread of its own.
+ * \ingroup spectrogram_blk
+ *
+ * \details
+ * Lives on the display's render thread and receives the sink's
+ * WaterfallUpdateEvent instead of the GUI. For each one it drains the
+ * row pool into the plot's history under the plot's render lock. Frames
+ * are rendered for every plot item at most at the plot's maximum frame
+ * rate; rows arriving sooner wait for a timer, so one frame covers them
+ * all. After each frame a WaterfallFrameEvent goes to \p receiver. The
+ * GUI thread takes the summary of the new rows with takeFrame() and only
+ * replots, which blits the finished frames.
+ */
+class SPECTROGRAM_API WaterfallRenderWorker : public QObject
+{
+public:
+    //! The rows added since the GUI last took a frame
+    struct Frame {
+        Frame();
+
+        uint64_t rows;
+        // Posting times of the oldest and the newest row
+        gr::high_res_timer_type oldest;
+        gr::high_res_timer_type newest;
+        // Lowest noise floor and highest peak level of the newest row
+        double noiseFloor;
+        double peakLevel;
+    };
+
+    WaterfallRenderWorker(WaterfallVectorDisplayPlot* plot, QObject* receiver);
+    ~WaterfallRenderWorker();
+
+    void setMetrics(WaterfallMetrics::sptr metrics);
+
+    // GUI side; returns false if no rows came in since the last call
+    bool takeFrame(Frame& frame);
+
+protected:
+    virtual void customEvent(QEvent* e);
+    virtual void timerEvent(QTimerEvent* e);
+
+private:
+    WaterfallVectorDisplayPlot* d_plot;
+    QObject* d_receiver;
+
+    QMutex d_mutex;
+    Frame d_frame;
+    bool d_frame_posted;
+    WaterfallMetrics::sptr d_metrics;
+
+    // Render thread only: rows added since the last frame, when it was
+    // rendered and the timer of a deferred one
+    Frame d_unrendered;
+    gr::high_res_timer_type d_last_render;
+    int d_render_timer;
+
+    void renderIfDue();
+    void render();
+};
+
+#endif /* WATERFALL_RENDER_WORKER_H */
@@ -0,0 +1,117 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef WATERFALL_ROW_POOL_H
+#define WATERFALL_ROW_POOL_H
+
+#include <spectrogram/api.h>
+#include <gnuradio/high_res_timer.h>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+#include <vector>
+
+/*!
+ * \brief Fixed pool of pre-allocated waterfall rows and the bounded
+ * handoff between the sink and the display.
+ * \ingroup spectrogram_blk
+ *
+ * \details
+ * Each slot holds one aligned row of \p rowLength floats per plot. The
+ * sink (the single producer) acquires a free slot, fills it in place and
+ * publishes it; the display's render thread (the single consumer) drains
+ * every published slot in one go and releases them back. Both directions are lock-free
+ * single-producer/single-consumer rings sized to the pool, so memory use
+ * is bounded and the update path never touches the heap.
+ *
+ * A published row may be shorter than the slot capacity and cover only
+ * part of the band, e.g. after the sink reduced it to the visible span;
+ * its length and span (as fractions of the band) travel with the slot.
+ *
+ * The producer also attaches the intensity statistics of every row
+ * (noise floor and peak level), so the consumer never has to
+ * scan a row.
+ *
+ * When the GUI falls behind, acquire() fails and the producer records a
+ * dropped row with markDropped(); the count is attached to the next
+ * published row so the display can leave a gap for it.
+ */
+class SPECTROGRAM_API WaterfallRowPool
+{
+public:
+    typedef boost::shared_ptr<WaterfallRowPool> sptr;
+
+    WaterfallRowPool(const unsigned int numSlots,
+                     const unsigned int numRows,
+                     const uint64_t rowLength);
+    ~WaterfallRowPool();
+
+    // Producer side
+    int acquire();
+    void markDropped();
+    void setRowStats(const int slot,
+                     const unsigned int row,
+                     const float noiseFloor,
+                     const float peakLevel);
+    // Returns true if the consumer has to be notified of new rows
+    bool publish(const int slot,
+                 const gr::high_res_timer_type timestamp,
+                 const uint64_t length = 0,
+                 const double spanLo = 0.0,
+                 const double spanHi = 1.0);
+
+    // Consumer side
+    void beginDrain();
+    bool consume(int &slot);
+    void release(const int slot);
+
+    const std::vector<float*>& rows(const int slot) const;
+    gr::high_res_timer_type timestamp(const int slot) const;
+    int droppedBefore(const int slot) const;
+    uint64_t rowLength(const int slot) const;
+    double spanLo(const int slot) const;
+    double spanHi(const int slot) const;
+    float noiseFloor(const int slot, const unsigned int row) const;
+    float peakLevel(const int slot, const unsigned int row) const;
+
+    unsigned int numSlots() const;
+    uint64_t rowLength() const;
+
+private:
+    std::vector<std::vector<float*> > d_slots;
+    std::vector<gr::high_res_timer_type> d_timestamps;
+    std::vector<int> d_dropped_before;
+    std::vector<uint64_t> d_lengths;
+    std::vector<double> d_span_lo;
+    std::vector<double> d_span_hi;
+    // Indexed by slot * numRows + row
+    std::vector<float> d_noise_floor;
+    std::vector<float> d_peak_level;
+    unsigned int d_num_rows;
+    uint64_t d_row_length;
+
+    boost::lockfree::spsc_queue<int> d_free;
+    boost::lockfree::spsc_queue<int> d_ready;
+    boost::atomic<bool> d_notify_pending;
+    int d_pending_drops;
+};
+
+#endif /* WATERFALL_ROW_POOL_H */
@@ -23,6 +23,7 @@
 
 #include <spectrogram/api.h>
 #include <spectrogram/form_menus.h>
+#include <spectrogram/WaterfallRenderWorker.h>
 #include <spectrogram/WaterfallVectorDisplayPlot.h>
 #include <spectrogram/WaterfallVectorUpdateEvents.h>
 #include <QtGui/QtGui>
@@ -43,6 +44,8 @@ public:
     ~WaterfallVectorDisplayForm();
 
     WaterfallVectorDisplayPlot *getPlot();
+    // Receives the sink's WaterfallUpdateEvents on the render thread
+    WaterfallRenderWorker *getRenderWorker();
 
     int getVecSize() const;
     double getTimePerVec();
@@ -54,6 +57,17 @@ public:
     double getMaxIntensity(int which);
 
     void clearData();
+    void setStorageType(const int type, const double offset, const double scale);
+    void setAggregation(const int mode);
+    int getAggregation();
+    uint64_t getHistoryMemory();
+    bool getAutoLevel() const;
+    void setMaxFrameRate(const double fps);
+    double getMaxFrameRate();
+    int getCompositeMode();
+    int getTileLayout();
+    void setMetrics(WaterfallMetrics::sptr metrics);
+    void setMetricsOverlay(const bool en);
 
     // returns the frequency that was last double-clicked on by the user
     float getClickedFreq() const;
@@ -61,6 +75,9 @@ public:
     // checks if there was a double-click event; reset if there was
     bool checkClicked();
 
+    // visible part of the band, as fractions of the bandwidth
+    void getVisibleSpan(double &spanLo, double &spanHi) const;
+
 public slots:
     void customEvent(QEvent *e);
     void setTimeTitle(const std::string);
@@ -75,21 +92,31 @@ public slots:
     void setMinIntensity(const QString &m);
 
     void setAlpha(int which, int alpha);
+    void setTileLayout(const int layout);
 
     void setColorMap(int which,
                      const int newType,
                      const QColor lowColor = QColor("white"),
                      const QColor highColor = QColor("white"));
 
+    // Scales to the current levels; \p en keeps following them
     void autoScale(bool en = false);
     void setTimePerVec(double t);
     void setUpdateTime(double t);
+    // Queued to the GUI thread when called from another one
+    void setNumRows(const int nrows);
+    void setHistoryTiers(const int tiers, const int decimation, const int mode);
+    void setCompositeMode(const int mode);
 
 private slots:
-    void newData(const QEvent *updateEvent);
+    void newData(const QEvent *frameEvent);
     void onPlotPointSelected(const QPointF p);
+    void onVisibleSpanChanged(double spanLo, double spanHi);
 
 private:
+    void _trackLevels();
+    void _updateMetricsOverlay();
+
     QIntValidator *d_int_validator;
 
     double d_samp_rate, d_center_freq;
@@ -101,11 +128,24 @@ private:
     bool d_clicked;
     double d_clicked_freq;
 
+    // Written on the GUI thread, read by the sink's work()
+    double d_span_lo, d_span_hi;
+    mutable QMutex d_span_lock;
+
+    // Lowest noise floor and highest peak level of the newest row
     double d_min_val, d_cur_min_val;
     double d_max_val, d_cur_max_val;
 
     VecSizeMenu *d_sizemenu;
     AverageMenu *d_avgmenu;
+    TileLayoutMenu *d_layoutmenu;
+
+    QThread *d_render_thread;
+    WaterfallRenderWorker *d_render_worker;
+
+    WaterfallMetrics::sptr d_metrics;
+    QLabel *d_metrics_label;
+    gr::high_res_timer_type d_metrics_shown;
 };
 
 #endif /* WATERFALL_VECTOR_DISPLAY_FORM_H */
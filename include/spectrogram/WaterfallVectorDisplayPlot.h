@@ -26,13 +26,15 @@
 #include <spectrogram/DisplayPlot.h>
 #include <spectrogram/WaterfallVectorGlobalData.h>
 #include <qwt_plot_spectrogram.h>
+#include <QMutex>
+#include <QTimer>
 #include <stdint.h>
 #include <cstdio>
 #include <vector>
 
-#if QWT_VERSION < 0x060000
 #include <spectrogram/plot_waterfall.h>
-#else
+
+#if QWT_VERSION >= 0x060000
 // clang-format off
 #include <qwt_point_3d.h> // doesn't seem necessary, but is...
 #include <qwt_compat.h>
@@ -69,26 +71,38 @@ public:
     double getStartFrequency() const;
     double getStopFrequency() const;
 
-    void plotNewData(const std::vector<double *> dataPoints,
-                     const int64_t numDataPoints,
-                     const double timePerVec,
-                     const gr::high_res_timer_type timestamp,
-                     const int droppedFrames);
+    // Render thread side: adds the rows of one pool slot to the history
+    // without touching any widget, then renderFrames() draws the items.
+    // Both take renderLock(), as does every setter changing the history.
+    bool addRowData(const std::vector<float *> &dataPoints,
+                    const int64_t numDataPoints,
+                    const double spanLo,
+                    const double spanHi,
+                    const int droppedFrames);
+    void renderFrames();
+    QMutex *renderLock();
 
-    // to be removed
-    void plotNewData(const double *dataPoints,
-                     const int64_t numDataPoints,
-                     const double timePerVec,
-                     const gr::high_res_timer_type timestamp,
-                     const int droppedFrames);
+    // Moves the time axis to a row added by addRowData()
+    void updateTimeAxis(const double timePerVec, const gr::high_res_timer_type timestamp);
 
     void setIntensityRange(const double minIntensity, const double maxIntensity);
     double getMinIntensity(int which) const;
     double getMaxIntensity(int which) const;
 
+    // Marks the plot dirty; the replot happens at most getMaxFrameRate()
+    // times per second however often this is called. Calls from other
+    // threads are queued to the GUI thread.
     void replot(void);
     void clearData();
 
+    // 0 replots on every replot() call
+    void setMaxFrameRate(const double fps);
+    double getMaxFrameRate() const;
+
+    // The next replot shows rows posted at \p timestamp or later; the
+    // delay until it is done goes to the metrics as LATENCY_DISPLAY
+    void addPendingRows(const gr::high_res_timer_type timestamp);
+
     int getIntensityColorMapType(int) const;
     int getIntensityColorMapType1() const;
     int getColorMapTitleFontSize() const;
@@ -99,6 +113,32 @@ public:
     void setAlpha(int which, int alpha);
 
     int getNumRows() const;
+    // Bytes held by the history of all channels
+    uint64_t getHistoryMemory() const;
+
+    void setStorageType(const int type, const double offset, const double scale);
+    int getStorageType() const;
+
+    void setAggregation(const int mode);
+    int getAggregation() const;
+
+    void setHistoryTiers(const int tiers, const int decimation, const int mode);
+    int getHistoryTiers() const;
+
+    // Draws every input into the first one's image (composite_mode_t)
+    void setCompositeMode(const int mode);
+    int getCompositeMode() const;
+
+    // Overlays or stacks the inputs (tile_layout_t); stacked inputs
+    // share the frequency axis and zoom and each renders only its band
+    void setTileLayout(const int layout);
+    int getTileLayout() const;
+
+    // Also captions the input's band when stacked
+    void setLineLabel(int which, QString label);
+
+    // Render and replot times go to \p metrics
+    void setMetrics(WaterfallMetrics::sptr metrics);
 
 public slots:
     void setIntensityColorMapType(const int, const int, const QColor, const QColor);
@@ -114,23 +154,59 @@ public slots:
 signals:
     void updatedLowerIntensityLevel(const double);
     void updatedUpperIntensityLevel(const double);
+    // Visible part of the band, as fractions of the bandwidth
+    void visibleSpanChanged(double spanLo, double spanHi);
+
+private slots:
+    void onXScaleDivChanged();
+    void flushReplot();
 
 private:
     void _updateIntensityRangeDisplay();
+    void _resizeData();
+    // Resamples the kept history onto a new row length or span
+    void _remapData();
+    void _resetZoom();
+    void _updateTiles();
 
     double d_start_frequency;
     double d_stop_frequency;
     double d_center_frequency;
+    double d_span_lo;
+    double d_span_hi;
     int d_xaxis_multiplier;
     bool d_legend_enabled;
     int d_nrows;
 
+    int d_storage_type;
+    double d_storage_offset;
+    double d_storage_scale;
+    int d_aggregation;
+    int d_history_tiers;
+    int d_tier_decimation;
+    int d_tier_reduce;
+    int d_composite_mode;
+    int d_tile_layout;
+    int d_tiles;
+    // Alphas set per input; stacked inputs are drawn opaque
+    std::vector<int> d_alpha;
+
+    // Recursive: setters holding it may replot, which can render
+    mutable QMutex d_render_lock;
+
+    double d_max_fps;
+    QTimer *d_replot_timer;
+    bool d_replot_pending;
+    gr::high_res_timer_type d_last_replot;
+    gr::high_res_timer_type d_oldest_pending;
+    WaterfallMetrics::sptr d_metrics;
+
     std::vector<WaterfallVectorData *> d_data;
 
 #if QWT_VERSION < 0x060000
     std::vector<PlotWaterfall *> d_spectrogram;
 #else
-    std::vector<QwtPlotSpectrogram *> d_spectrogram;
+    std::vector<WaterfallSpectrogram *> d_spectrogram;
 #endif
 
     std::vector<int> d_intensity_color_map_type;
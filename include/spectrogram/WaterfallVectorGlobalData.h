@@ -22,8 +22,11 @@
 #define WATERFALL_VECTOR_GLOBAL_DATA_H
 
 #include <spectrogram/api.h>
+#include <spectrogram/bin_reduce.h>
+#include <spectrogram/storage_type.h>
 #include <inttypes.h>
 #include <qwt_raster_data.h>
+#include <vector>
 
 #if QWT_VERSION >= 0x060000
 // clang-format off
@@ -32,10 +35,47 @@
 // clang-format on
 #endif
 
+/*!
+ * \brief Raster data holding the scrolling history of a waterfall plot.
+ *
+ * \details
+ * Rows are kept in a circular buffer of \p historyExtent lines. Logical
+ * row 0 is the oldest line and row getNumRows()-1 the newest; the
+ * physical position of the oldest line is given by getHistoryHead().
+ * Adding a row only advances the head, so the cost of addVecData() does
+ * not depend on the history depth.
+ *
+ * setHistoryTiers() adds coarser tiers of historyExtent lines each below
+ * the full-resolution one. Lines leaving a tier are pooled (max or mean)
+ * by the decimation factor into the next, so tier k shows decimation^k
+ * rows per line and the history covers a long time span at a fixed
+ * memory and render cost.
+ *
+ * Samples are stored in the format selected with setStorageType(); the
+ * quantized formats trade intensity resolution for a half or a quarter
+ * of the memory and copy bandwidth of float storage.
+ *
+ * Between initRaster() and discardRaster() the bin of every image column
+ * and the history row of every image line are held in tables, so
+ * renderers can fill whole lines with getRasterLine() instead of calling
+ * value() per pixel.
+ *
+ * With an aggregation mode set, every row also keeps a pyramid of
+ * halved levels (max or mean of bin pairs), updated as rows arrive and
+ * stored in the same format as the rows.
+ * Raster lines then show the max or mean over all bins and rows a
+ * pixel covers, read from the few pyramid cells that tile its bins.
+ */
 class SPECTROGRAM_API WaterfallVectorData : public QwtRasterData
 {
 public:
-    WaterfallVectorData(const double, const double, const uint64_t, const unsigned int);
+    WaterfallVectorData(const double,
+                        const double,
+                        const uint64_t,
+                        const unsigned int,
+                        const int storageType = gr::spectrogram::STORAGE_FLOAT,
+                        const double storageOffset = -150.0,
+                        const double storageScale = 0.0);
     virtual ~WaterfallVectorData();
 
     virtual void reset();
@@ -43,6 +83,10 @@ public:
 
     virtual void
     resizeData(const double, const double, const uint64_t, const int history = 0);
+    // Resamples the history to \p vecPoints bins over a new frequency
+    // range, nearest bin first; bins the old range did not cover read as
+    // the bottom of the intensity range
+    virtual void remapData(const double, const double, const uint64_t);
 
     virtual QwtRasterData *copy() const;
 
@@ -52,23 +96,144 @@ public:
 #endif
 
     virtual double value(double x, double y) const;
+    // Logical history row shown at y, or -1 outside the history
+    int64_t rowIndex(double y) const;
 
-    virtual uint64_t getNumVecPoints() const;
-    virtual void addVecData(const double *, const uint64_t, const int);
-
-    virtual double *getSpectrumDataBuffer() const;
-    virtual void setSpectrumDataBuffer(const double *);
+#if QWT_VERSION < 0x060000
+    virtual void initRaster(const QwtDoubleRect &, const QSize &);
+#else
+    virtual void initRaster(const QRectF &, const QSize &);
+#endif
+    virtual void discardRaster();
+    // Row of each raster line, top line (largest y) first
+    const std::vector<int64_t> &getRasterRows() const;
+    // Decodes a logical row at the bins of the raster columns; when
+    // aggregating, covers \p rows rows ending at \p row
+    void getRasterLine(const int64_t row, float *lineData, const int64_t rows = 1) const;
+
+    // gr::spectrogram::bin_reduce_t applied to pixels covering several
+    // bins or rows; BIN_REDUCE_NONE shows the nearest one
+    virtual int getAggregation() const;
+    virtual void setAggregation(const int mode);
 
+    virtual uint64_t getNumVecPoints() const;
+    // Lines per tier, and lines over all tiers
+    virtual uint64_t getHistoryLength() const;
+    virtual uint64_t getNumRows() const;
+    // Resizes every tier to \p history lines in one reallocation,
+    // keeping the newest lines that still fit
+    virtual void setHistoryLength(const uint64_t history);
+    // Bytes held by the history, its pyramid and the tier accumulators
+    virtual uint64_t getMemoryUsage() const;
+
+    // Adds \p tiers coarser tiers, each pooling \p decimation lines of
+    // the previous one with \p mode (gr::spectrogram::bin_reduce_t);
+    // clears the history
+    virtual void
+    setHistoryTiers(const unsigned int tiers, const unsigned int decimation, const int mode);
+    virtual unsigned int getHistoryTiers() const;
+    virtual unsigned int getTierDecimation() const;
+    virtual void addVecData(const float *, const uint64_t, const int);
+
+    virtual int getStorageType() const;
+    virtual double getStorageOffset() const;
+    virtual double getStorageScale() const;
+    virtual void setStorageType(const int type,
+                                const double offset = -150.0,
+                                const double scale = 0.0);
+
+    // Raw ring storage in getStorageType() format; row getHistoryHead()
+    // holds the oldest line
+    virtual void *getSpectrumDataBuffer() const;
+    // Replaces the history with linear data ordered oldest line first
+    virtual void setSpectrumDataBuffer(const float *);
+
+    virtual uint64_t getHistoryHead() const;
+    // Row that showed the content of \p row before the lines counted by
+    // getNumLinesToUpdate() came in, or -1 if it was not displayed
+    int64_t getPreviousRow(const int64_t row) const;
+    virtual bool isRowValid(const uint64_t row) const;
+    // Decodes a logical row; rows zero-filled by dropped frames read as 0
+    virtual bool getRow(const uint64_t row, float *rowData) const;
+
+    // Rows added since the count was last set to 0, or -1 after a reset
     virtual int getNumLinesToUpdate() const;
     virtual void setNumLinesToUpdate(const int);
     virtual void incrementNumLinesToUpdate();
 
 protected:
-    double *_spectrumData;
+    uint8_t *_spectrumData;
     uint64_t _vecPoints;
     uint64_t _historyLength;
+    std::vector<uint8_t> _rowValid;
     int _numLinesToUpdate;
 
+    // Tier 0 is the full-resolution history; tier k the lines pooled
+    // from the ones leaving tier k-1. Each tier has its own ring head,
+    // lines added since the last render and partial pooled line.
+    unsigned int _historyTiers;
+    unsigned int _tierDecimation;
+    int _tierReduce;
+    std::vector<uint64_t> _tierHead;
+    std::vector<uint64_t> _tierScrolled;
+    std::vector<float> _tierAccum;
+    std::vector<unsigned int> _tierCount;
+    std::vector<unsigned int> _tierValid;
+
+    // Bin of each raster column (-1 outside the data) and row of each
+    // raster line, valid between initRaster() and discardRaster()
+    std::vector<int64_t> _rasterBins;
+    std::vector<int64_t> _rasterRows;
+    // When aggregating, the pyramid cells exactly covering each column:
+    // cells _rasterCellStart[col] up to _rasterCellStart[col + 1], each a
+    // pyramid row offset, or -(bin + 1) for a single stored bin
+    std::vector<size_t> _rasterCellStart;
+    std::vector<int64_t> _rasterCells;
+    std::vector<float> _rasterCellWeights;
+
+    // Per physical row, levels 1.._pyramidLevels of the aggregation
+    // pyramid in the storage format; level l starts at sample
+    // _levelOffset[l] and holds _levelSize[l] samples. The scratch line
+    // holds a decoded row followed by its levels as floats.
+    int _aggregation;
+    unsigned int _pyramidLevels;
+    uint64_t _pyramidStride;
+    std::vector<uint64_t> _levelOffset;
+    std::vector<uint64_t> _levelSize;
+    std::vector<uint8_t> _pyramid;
+    std::vector<float> _pyramidScratch;
+
+    int _storageType;
+    double _storageOffset;
+    double _storageScale;
+
+    void _allocateData();
+    size_t _sampleSize() const;
+    void _storeRow(const uint64_t row, const float *rowData);
+    double _sample(const uint64_t row, const uint64_t bin) const;
+    void _decodeRow(const uint64_t row, float *rowData) const;
+    void _allocatePyramid();
+    void _updatePyramid(const uint64_t row);
+    void _buildPyramid();
+    void _getAggregatedLine(const int64_t row, float *lineData, const int64_t rows) const;
+    void _pushRow(const unsigned int tier, const float *rowData);
+    void _feedTier(const unsigned int tier, const uint64_t row);
+
+    // Logical rows run from the oldest line of the coarsest tier to the
+    // newest full-resolution line
+    inline uint64_t _physicalRow(const uint64_t row) const
+    {
+        uint64_t tier = 0;
+        uint64_t r = row;
+        if (_historyTiers) {
+            const uint64_t block = row / _historyLength;
+            tier = _historyTiers - block;
+            r -= block * _historyLength;
+        }
+        r += _tierHead[tier];
+        return tier * _historyLength + ((r >= _historyLength) ? r - _historyLength : r);
+    }
+
 #if QWT_VERSION < 0x060000
     QwtDoubleInterval _intensityRange;
 #else
@@ -23,6 +23,7 @@
 
 #include <gnuradio/high_res_timer.h>
 #include <spectrogram/api.h>
+#include <spectrogram/WaterfallRowPool.h>
 #include <gnuradio/tags.h>
 #include <stdint.h>
 #include <QEvent>
@@ -34,32 +35,47 @@ static const int SpectrumUpdateEventType = 10005;
 static const int SpectrumWindowCaptionEventType = 10008;
 static const int SpectrumWindowResetEventType = 10009;
 static const int SpectrumFrequencyRangeEventType = 10010;
+static const int SpectrumFrameEventType = 10011;
 
+/*!
+ * \brief Tells the GUI that rows are waiting in a WaterfallRowPool.
+ *
+ * \details
+ * The rows themselves stay in the pool; the sink posts at most one of
+ * these until the GUI has started draining, so a stalled event loop
+ * never accumulates more than one pending update per sink.
+ */
 class SPECTROGRAM_API WaterfallUpdateEvent : public QEvent
 {
 public:
-    WaterfallUpdateEvent(const std::vector<double *> dataPoints,
-                         const uint64_t numDataPoints,
-                         const gr::high_res_timer_type dataTimestamp);
+    WaterfallUpdateEvent(WaterfallRowPool::sptr pool);
 
     ~WaterfallUpdateEvent();
 
-    int which() const;
-    const std::vector<double *> getPoints() const;
-    uint64_t getNumDataPoints() const;
-    bool getRepeatDataFlag() const;
-
-    gr::high_res_timer_type getDataTimestamp() const;
+    WaterfallRowPool::sptr getRowPool() const;
 
     static QEvent::Type Type() { return QEvent::Type(SpectrumUpdateEventType); }
 
 protected:
 private:
-    size_t _nplots;
-    std::vector<double *> _dataPoints;
-    uint64_t _numDataPoints;
+    WaterfallRowPool::sptr _pool;
+};
+
+/*!
+ * \brief Tells the GUI that the render thread finished a frame.
+ *
+ * \details
+ * Carries nothing: the GUI takes what changed from the
+ * WaterfallRenderer and replots, which shows the frame. As with
+ * WaterfallUpdateEvent at most one is pending at a time.
+ */
+class SPECTROGRAM_API WaterfallFrameEvent : public QEvent
+{
+public:
+    WaterfallFrameEvent();
+    ~WaterfallFrameEvent();
 
-    gr::high_res_timer_type _dataTimestamp;
+    static QEvent::Type Type() { return QEvent::Type(SpectrumFrameEventType); }
 };
 
 /********************************************************************/
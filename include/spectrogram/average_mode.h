@@ -0,0 +1,44 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_AVERAGE_MODE_H
+#define INCLUDED_SPECTROGRAM_AVERAGE_MODE_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief How the sink combines the input vectors between two displayed
+ * rows.
+ * \ingroup spectrogram
+ */
+enum average_mode_t {
+  AVERAGE_EXPONENTIAL = 0, //!< running exponential average of every vector
+  AVERAGE_PEAK_HOLD = 1,   //!< per-bin maximum since the last displayed row
+  AVERAGE_MAX_HOLD = 2,    //!< per-bin maximum since the last reset
+  AVERAGE_MIN_HOLD = 3,    //!< per-bin minimum since the last reset
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_AVERAGE_MODE_H */
@@ -0,0 +1,43 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_BIN_REDUCE_H
+#define INCLUDED_SPECTROGRAM_BIN_REDUCE_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief How the sink reduces the visible bins of a row to the display
+ * width before handing it to the GUI.
+ * \ingroup spectrogram
+ */
+enum bin_reduce_t {
+  BIN_REDUCE_NONE = 0, //!< send every bin of the full band
+  BIN_REDUCE_MAX = 1,  //!< each display bin is the max of the bins it covers
+  BIN_REDUCE_MEAN = 2, //!< each display bin is the mean of the bins it covers
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_BIN_REDUCE_H */
@@ -0,0 +1,42 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_COMPOSITE_MODE_H
+#define INCLUDED_SPECTROGRAM_COMPOSITE_MODE_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief How the waterfall shows several inputs on one plot.
+ * \ingroup spectrogram
+ */
+enum composite_mode_t {
+  COMPOSITE_NONE = 0,  //!< one image per input, blended with its alpha when drawn
+  COMPOSITE_BLEND = 1, //!< all inputs alpha-blended into one image in a single pass
+  COMPOSITE_MAX = 2,   //!< one image of the highest intensity of all inputs
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_COMPOSITE_MODE_H */
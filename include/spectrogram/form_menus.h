@@ -23,6 +23,7 @@
 
 #include <spectrogram/api.h>
 #include <spectrogram/spectrogram_types.h>
+#include <spectrogram/tile_layout.h>
 #include <QtGui/QDoubleValidator>
 #include <QtGui/QIntValidator>
 #include <QtGui/QtGui>
@@ -935,6 +936,55 @@ private:
 
 /********************************************************************/
 
+class SPECTROGRAM_API TileLayoutMenu : public QMenu
+{
+    Q_OBJECT
+
+public:
+    TileLayoutMenu(QWidget *parent) : QMenu("Layout", parent)
+    {
+        d_grp = new QActionGroup(this);
+        d_act.push_back(new QAction("Overlay", this));
+        d_act.push_back(new QAction("Stacked", this));
+
+        connect(d_act[0], SIGNAL(triggered()), this, SLOT(getOverlay()));
+        connect(d_act[1], SIGNAL(triggered()), this, SLOT(getStacked()));
+
+        QListIterator<QAction *> i(d_act);
+        while (i.hasNext())
+        {
+            QAction *a = i.next();
+            a->setCheckable(true);
+            a->setActionGroup(d_grp);
+            addAction(a);
+        }
+        d_act[0]->setChecked(true);
+    }
+
+    ~TileLayoutMenu() {}
+
+    QAction *getAction(int layout)
+    {
+        if (layout >= 0 && layout < d_act.size())
+            return d_act[layout];
+        else
+            throw std::runtime_error("TileLayoutMenu::getAction: unknown layout.\n");
+    }
+
+signals:
+    void whichTrigger(const int layout);
+
+public slots:
+    void getOverlay() { emit whichTrigger(gr::spectrogram::TILE_OVERLAY); }
+    void getStacked() { emit whichTrigger(gr::spectrogram::TILE_STACKED); }
+
+private:
+    QList<QAction *> d_act;
+    QActionGroup *d_grp;
+};
+
+/********************************************************************/
+
 class SPECTROGRAM_API TriggerChannelMenu : public QMenu
 {
     Q_OBJECT
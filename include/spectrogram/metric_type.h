@@ -0,0 +1,59 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_METRIC_TYPE_H
+#define INCLUDED_SPECTROGRAM_METRIC_TYPE_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Event counters kept by the waterfall sink and its display.
+ * \ingroup spectrogram
+ */
+enum counter_t {
+  COUNTER_VECTORS_CONSUMED = 0, //!< input vectors taken by work()
+  COUNTER_ROWS_POSTED = 1,      //!< rows handed to the display
+  COUNTER_ROWS_COALESCED = 2,   //!< posted rows that rode along an earlier update event
+  COUNTER_ROWS_DROPPED = 3,     //!< rows lost because every pool slot was in flight
+  COUNTER_ROWS_RENDERED = 4,    //!< rows drawn into a rendered frame
+  COUNTER_EVENTS_POSTED = 5,    //!< update events posted to the render thread
+  COUNTER_EVENTS_HANDLED = 6,   //!< update events handled by the render thread
+  NUM_COUNTERS = 7,
+};
+
+/*!
+ * \brief Latencies sampled by the waterfall sink and its display.
+ * \ingroup spectrogram
+ */
+enum latency_t {
+  LATENCY_AVERAGING = 0, //!< folding the input vectors of one row
+  LATENCY_RENDER = 1,    //!< one renderImage() of one plot
+  LATENCY_REPLOT = 2,    //!< one replot of the whole display
+  LATENCY_DISPLAY = 3,   //!< from a row being posted to it being on screen
+  NUM_LATENCIES = 4,
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_METRIC_TYPE_H */
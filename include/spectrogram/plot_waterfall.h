@@ -22,9 +22,12 @@
 #define PLOT_WATERFALL_H
 
 #include <spectrogram/api.h>
+#include <spectrogram/WaterfallMetrics.h>
 #include <spectrogram/WaterfallVectorGlobalData.h>
 #include <qglobal.h>
 #include <qwt_plot_rasteritem.h>
+#include <qwt_plot_spectrogram.h>
+#include <vector>
 
 #if QWT_VERSION >= 0x060000
 // clang-format off
@@ -34,6 +37,7 @@
 #endif
 
 class QwtColorMap;
+class QMutex;
 
 /*!
  * \brief A plot item, which displays a waterfall spectrogram
@@ -58,6 +62,22 @@ public:
 
     const QwtColorMap& colorMap() const;
 
+    // Forces the next render to redraw every line instead of scrolling
+    void invalidateImage();
+    void setMetrics(WaterfallMetrics::sptr metrics);
+
+    // With a render thread feeding the item, draws show its latest frame
+    void setRenderLock(QMutex* lock);
+    void renderFrame();
+
+    // Renders the other inputs' items into this one's image
+    void setComposite(const int mode, const std::vector<PlotWaterfall*>& layers);
+    // Draws into one of \p count bands stacked over the canvas
+    void setTile(const int index, const int count);
+
+    void setRenderThreadCount(unsigned int numThreads);
+    unsigned int renderThreadCount() const;
+
 #if QWT_VERSION < 0x060000
     virtual QwtDoubleRect boundingRect() const;
     virtual QSize rasterHint(const QwtDoubleRect&) const;
@@ -83,8 +103,86 @@ protected:
 #endif
 
 private:
+#if QWT_VERSION < 0x060000
+    QImage renderNewImage(const QwtScaleMap& xMap,
+                          const QwtScaleMap& yMap,
+                          const QwtDoubleRect& rect) const;
+#else
+    QImage renderNewImage(const QwtScaleMap& xMap,
+                          const QwtScaleMap& yMap,
+                          const QRectF& rect,
+                          const QSize& size = QSize(0, 0)) const;
+#endif
+
+    class PrivateData;
+    PrivateData* d_data;
+};
+
+#if QWT_VERSION >= 0x060000
+/*!
+ * \brief QwtPlotSpectrogram that scrolls its previous image
+ * \ingroup spectrogram_blk
+ *
+ * \details
+ * When only new rows were added since the last render, the previous
+ * image is shifted by that many rows and only the lines showing new
+ * rows are rendered. Zooming, resizing or a new intensity range
+ * redraw everything; call invalidateImage() after changing the colour
+ * map. Large redraws are split into bands rendered concurrently on
+ * renderThreadCount() threads.
+ *
+ * Once setRenderLock() is called a render thread owns the rendering:
+ * it calls renderFrame() with the lock held whenever rows came in, and
+ * renderImage() on the GUI thread just returns that frame. Only when the
+ * view changed (zoom, resize, intensity range) does the GUI thread take
+ * the lock and render the frame itself.
+ */
+class SPECTROGRAM_API WaterfallSpectrogram : public QwtPlotSpectrogram
+{
+public:
+    explicit WaterfallSpectrogram(WaterfallVectorData* data,
+                                  const QString& title = QString::null);
+    virtual ~WaterfallSpectrogram();
+
+    void invalidateImage();
+    // Records the time of every renderImage() in \p metrics
+    void setMetrics(WaterfallMetrics::sptr metrics);
+
+    // \p lock guards the data between the render thread and the GUI
+    void setRenderLock(QMutex* lock);
+    // Renders for the maps of the last draw; call with the lock held
+    void renderFrame();
+
+    // Renders \p layers into this item's image, see composite_mode_t
+    void setComposite(const int mode, const std::vector<WaterfallSpectrogram*>& layers);
+    // Draws into one of \p count bands stacked over the canvas
+    void setTile(const int index, const int count);
+
+#if QWT_VERSION < 0x060100
+    // QwtPlotRasterItem only has these from Qwt 6.1
+    void setRenderThreadCount(unsigned int numThreads);
+    unsigned int renderThreadCount() const;
+#endif
+
+    virtual QImage renderImage(const QwtScaleMap& xMap,
+                               const QwtScaleMap& yMap,
+                               const QRectF& area,
+                               const QSize& imageSize) const;
+
+    virtual void draw(QPainter* painter,
+                      const QwtScaleMap& xMap,
+                      const QwtScaleMap& yMap,
+                      const QRectF& canvasRect) const;
+
+private:
+    QImage renderNewImage(const QwtScaleMap& xMap,
+                          const QwtScaleMap& yMap,
+                          const QRectF& area,
+                          const QSize& imageSize) const;
+
     class PrivateData;
     PrivateData* d_data;
 };
+#endif
 
 #endif
@@ -81,6 +81,9 @@ public:
     {
         _zeroTime = 0;
         _secondsPerLine = 1.0;
+        _tierLines = 0;
+        _tiers = 0;
+        _tierDecimation = 1;
     }
 
     virtual ~TimeScaleData() {}
@@ -96,11 +99,39 @@ public:
 
     virtual double getSecondsPerLine() const { return _secondsPerLine; }
 
+    // Lines per history tier, number of coarser tiers and the lines of
+    // the previous tier pooled into each of their lines
+    virtual void setHistoryTiers(const double tierLines,
+                                 const unsigned int tiers,
+                                 const unsigned int decimation)
+    {
+        _tierLines = tierLines;
+        _tiers = tiers;
+        _tierDecimation = decimation;
+    }
+
+    // Age in seconds of the line that many lines from the newest; each
+    // coarser tier covers decimation times more seconds per line
+    virtual double getSecondsAt(const double line) const
+    {
+        double lines = 0.0;
+        double step = 1.0;
+        double start = 0.0;
+        for (unsigned int tier = 0; (tier < _tiers) && (line >= start + _tierLines); tier++) {
+            lines += _tierLines * step;
+            step *= _tierDecimation;
+            start += _tierLines;
+        }
+        return (lines + (line - start) * step) * _secondsPerLine;
+    }
 
 protected:
 private:
     gr::high_res_timer_type _zeroTime;
     double _secondsPerLine;
+    double _tierLines;
+    unsigned int _tiers;
+    unsigned int _tierDecimation;
 };
 
 /***********************************************************************
@@ -0,0 +1,48 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_STORAGE_TYPE_H
+#define INCLUDED_SPECTROGRAM_STORAGE_TYPE_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Sample format of the waterfall history buffer.
+ * \ingroup spectrogram
+ *
+ * \details
+ * The quantized formats store each bin as
+ * round((value - offset) / scale), clamped to the range of the type,
+ * and read it back as offset + code * scale. A scale of 0 spreads 204 dB
+ * above the offset over the codes of the type.
+ */
+enum storage_type_t {
+  STORAGE_FLOAT = 0,  //!< 32-bit float, full input precision
+  STORAGE_UINT16 = 1, //!< 16-bit code with explicit offset/scale
+  STORAGE_UINT8 = 2,  //!< 8-bit code with explicit offset/scale
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_STORAGE_TYPE_H */
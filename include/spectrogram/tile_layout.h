@@ -0,0 +1,41 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_TILE_LAYOUT_H
+#define INCLUDED_SPECTROGRAM_TILE_LAYOUT_H
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Where the waterfall draws each of several inputs.
+ * \ingroup spectrogram
+ */
+enum tile_layout_t {
+  TILE_OVERLAY = 0, //!< every input over the whole plot, blended with its alpha
+  TILE_STACKED = 1, //!< one band per input, stacked top to bottom
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_TILE_LAYOUT_H */
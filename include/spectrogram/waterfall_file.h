@@ -0,0 +1,171 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_WATERFALL_FILE_H
+#define INCLUDED_SPECTROGRAM_WATERFALL_FILE_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/storage_type.h>
+#include <gnuradio/thread/thread.h>
+#include <stdint.h>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief On-disk layout of a waterfall recording.
+ *
+ * \details
+ * A recording is a waterfall_file_header followed by fixed-size records,
+ * all in host byte order. Record i starts at
+ * header_size + i * record_size, so the file can be mmap'ed and indexed
+ * directly; the number of records is (file size - header_size) /
+ * record_size and the file is only ever appended to. Each record is a
+ * waterfall_file_record followed by nchannels rows of vec_points samples
+ * in the storage_type format (see storage_type_t), zero padded to
+ * record_size, which is a multiple of WATERFALL_FILE_ALIGN.
+ *
+ * Row timestamps are gr::high_res_timer ticks; the UTC time of a row in
+ * seconds is (timestamp - timestamp_epoch) / timestamp_tps.
+ */
+static const char WATERFALL_FILE_MAGIC[8] = { 'G', 'R', 'W', 'F', 'A', 'L', 'L', '\0' };
+static const uint32_t WATERFALL_FILE_VERSION = 1;
+static const uint32_t WATERFALL_FILE_ALIGN = 64;
+
+struct waterfall_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  uint32_t nchannels;
+  uint32_t vec_points;
+  uint32_t storage_type;
+  double storage_offset;
+  double storage_scale;
+  double timestamp_tps;
+  int64_t timestamp_epoch;
+  uint8_t reserved[64];
+};
+
+struct waterfall_file_record {
+  int64_t timestamp;
+  double center_freq;
+  double bandwidth;
+  uint32_t flags;
+  uint32_t reserved;
+};
+
+/*!
+ * \brief Appends waterfall rows to a recording file.
+ *
+ * \details
+ * A row is assembled in memory with begin_row() and write_channel() and
+ * written as one record, so a file cut short by a crash holds only
+ * whole records (plus at most one partial one at the end).
+ *
+ * end_row() only queues the record; a writer thread started by open()
+ * does the file I/O, so the caller never waits on the disk. When the
+ * disk falls MAX_PENDING_ROWS records behind, further rows are dropped
+ * and counted until it catches up. close() writes out what is queued.
+ */
+class SPECTROGRAM_API waterfall_file_writer
+{
+public:
+  waterfall_file_writer();
+  ~waterfall_file_writer();
+
+  bool open(const std::string &filename,
+            unsigned int nchannels,
+            unsigned int vec_points,
+            storage_type_t storage = STORAGE_FLOAT,
+            double storage_offset = -150.0,
+            double storage_scale = 0.0);
+  void close();
+  bool is_open() const { return d_fp != NULL; }
+  uint64_t rows_written() const;
+  uint64_t rows_dropped() const;
+
+  void begin_row(int64_t timestamp, double center_freq, double bandwidth);
+  void write_channel(unsigned int channel, const float *row);
+  //! Queues the row; false if it was dropped or a write has failed
+  bool end_row();
+
+  static const size_t MAX_PENDING_ROWS = 64;
+
+private:
+  FILE *d_fp;
+  waterfall_file_header d_header;
+  std::vector<uint8_t> d_record;
+
+  // Records waiting for the writer thread and spare record buffers,
+  // guarded by d_mutex like the counters and flags below
+  mutable gr::thread::mutex d_mutex;
+  gr::thread::condition_variable d_cond;
+  gr::thread::thread d_thread;
+  std::deque<std::vector<uint8_t> > d_pending;
+  std::vector<std::vector<uint8_t> > d_spare;
+  uint64_t d_rows;
+  uint64_t d_dropped;
+  bool d_closing;
+  bool d_failed;
+
+  void run();
+};
+
+/*!
+ * \brief Memory-maps a recording for random access to its rows.
+ */
+class SPECTROGRAM_API waterfall_file_reader
+{
+public:
+  waterfall_file_reader();
+  ~waterfall_file_reader();
+
+  bool open(const std::string &filename);
+  void close();
+  bool is_open() const { return d_base != NULL; }
+
+  const waterfall_file_header &header() const { return *d_header; }
+  uint64_t nrows() const { return d_rows; }
+
+  const waterfall_file_record *record(uint64_t row) const;
+  //! Raw samples of \p channel in row \p row, in the header's storage format
+  const void *data(uint64_t row, unsigned int channel) const;
+  //! Decodes \p channel of row \p row to dB into \p out (vec_points values)
+  bool read_row(uint64_t row, unsigned int channel, float *out) const;
+
+private:
+  uint8_t *d_base;
+  size_t d_length;
+  const waterfall_file_header *d_header;
+  uint64_t d_rows;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_WATERFALL_FILE_H */
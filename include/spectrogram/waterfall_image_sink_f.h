@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_H
+#define INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/average_mode.h>
+#include <spectrogram/storage_type.h>
+#include <gnuradio/sync_block.h>
+#include <QImage>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+    /*!
+     * \brief A headless waterfall sink rendering into offscreen images.
+     * \ingroup spectrogram
+     *
+     * \details
+     * Same averaging, history and colour maps as
+     * gr::spectrogram::waterfall_vector_sink_f, but without a
+     * QApplication or any widget, so it runs on servers without a
+     * display. Rows are only added to the history in work(); an image
+     * is rendered when one is asked for with image(), rgba() or
+     * save_image().
+     */
+class SPECTROGRAM_API waterfall_image_sink_f : virtual public gr::sync_block
+{
+public:
+  typedef boost::shared_ptr<waterfall_image_sink_f> sptr;
+      /*!
+       * \brief Build a headless floating point waterfall sink.
+       *
+       * \param vecsize size of the input vector
+       * \param freqcenter center frequency of signal
+       * \param bandwidth bandwidth of signal
+       * \param nconnections number of signals connected to the sink
+       * \param width width of the rendered images in pixels; 0 uses
+       *        one pixel per bin
+       * \param nrows number of rows in the history and height of the
+       *        rendered images
+       * \param storage sample format of the waterfall history
+       *        (see gr::spectrogram::storage_type_t)
+       * \param storage_offset intensity (dB) stored as code 0 by the
+       *        quantized storage formats
+       * \param storage_scale intensity step (dB) per code of the
+       *        quantized storage formats; 0 spreads 204 dB above the
+       *        offset over the codes of the format
+       */
+  static sptr make(int vecsize,
+                   double freqcenter, double bandwidth,
+                   int nconnections = 1,
+                   int width = 0,
+                   int nrows = 200,
+                   storage_type_t storage = STORAGE_FLOAT,
+                   double storage_offset = -150.0,
+                   double storage_scale = 0.0);
+
+  virtual void clear_data() = 0;
+
+  virtual int vec_size() const = 0;
+  virtual int width() const = 0;
+  virtual int nrows() const = 0;
+
+  virtual void set_vec_average(const float vecavg) = 0;
+  virtual float vec_average() const = 0;
+  virtual void set_average_mode(const average_mode_t mode) = 0;
+  virtual average_mode_t average_mode() const = 0;
+
+  /*!
+   * \brief Integrates exactly \p count input vectors per row, see
+   * waterfall_vector_sink_f::set_integration(). A \p count of 0 takes a
+   * row every set_update_time() seconds.
+   */
+  virtual void set_integration(const int count) = 0;
+  virtual int integration() const = 0;
+  virtual void set_update_time(double t) = 0;
+
+  virtual void set_frequency_range(const double centerfreq,
+                                   const double bandwidth) = 0;
+  virtual double center_freq() const = 0;
+  virtual double bandwidth() const = 0;
+
+  virtual void set_intensity_range(const double min,
+                                   const double max) = 0;
+  virtual void set_color_map(int which, const int color) = 0;
+  virtual int color_map(int which) = 0;
+
+  //! Renders the history of connection \p which
+  virtual QImage image(int which) = 0;
+
+  //! Renders connection \p which as width() x nrows() RGBA bytes
+  virtual std::vector<uint8_t> rgba(int which) = 0;
+
+  //! Renders connection \p which to an image file (format from the suffix)
+  virtual bool save_image(int which, const std::string &filename) = 0;
+
+  //! Records every row to \p filename, see waterfall_vector_sink_f::start_recording()
+  virtual bool start_recording(const std::string &filename) = 0;
+  virtual void stop_recording() = 0;
+  virtual bool recording() const = 0;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_H */
@@ -26,6 +26,12 @@
 #endif
 
 #include <spectrogram/api.h>
+#include <spectrogram/average_mode.h>
+#include <spectrogram/bin_reduce.h>
+#include <spectrogram/composite_mode.h>
+#include <spectrogram/metric_type.h>
+#include <spectrogram/storage_type.h>
+#include <spectrogram/tile_layout.h>
 #include <gnuradio/sync_block.h>
 #include <qapplication.h>
 
@@ -60,12 +66,25 @@ public:
        *        connection, and this value must be set to 0 if only
        *        the PDU message port is being used.
        * \param parent a QWidget parent object, if any
+       * \param storage sample format of the waterfall history
+       *        (see gr::spectrogram::storage_type_t)
+       * \param storage_offset intensity (dB) stored as code 0 by the
+       *        quantized storage formats
+       * \param storage_scale intensity step (dB) per code of the
+       *        quantized storage formats; 0 spreads 204 dB above the
+       *        offset over the codes of the format
+       * \param nrows number of full-resolution rows kept in the
+       *        history of each connection (see set_nrows())
        */
   static sptr make(int vecsize,
                    double freqcenter, double bandwidth,
                    const std::string &name,
                    int nconnections = 1,
-                   QWidget *parent = NULL);
+                   QWidget *parent = NULL,
+                   storage_type_t storage = STORAGE_FLOAT,
+                   double storage_offset = -150.0,
+                   double storage_scale = 0.0,
+                   int nrows = 200);
 
   virtual void exec_() = 0;
   virtual QWidget *qwidget() = 0;
@@ -78,18 +97,167 @@ public:
 
   virtual void clear_data() = 0;
 
+  virtual storage_type_t storage_type() const = 0;
+
+  /*!
+   * \brief Starts writing every displayed row to \p filename.
+   *
+   * \details
+   * Rows are recorded at full resolution, in the history storage format,
+   * with their timestamp, centre frequency and bandwidth, using the
+   * memory-mappable layout described in spectrogram/waterfall_file.h.
+   * Rows the GUI drops because it is behind are still recorded. An
+   * existing file is overwritten. Returns false if the file cannot be
+   * created.
+   */
+  virtual bool start_recording(const std::string &filename) = 0;
+  virtual void stop_recording() = 0;
+  virtual bool recording() const = 0;
+
   virtual void set_vec_size(const int vecsize) = 0;
   virtual int vec_size() const = 0;
   virtual void set_time_per_vec(const double t) = 0;
   virtual void set_vec_average(const float vecavg) = 0;
   virtual float vec_average() const = 0;
 
+  /*!
+   * \brief Selects how every input vector is combined into the next
+   * displayed row (see gr::spectrogram::average_mode_t). Changing the
+   * mode, or calling clear_data(), restarts the max/min hold.
+   */
+  virtual void set_average_mode(const average_mode_t mode) = 0;
+  virtual average_mode_t average_mode() const = 0;
+
+  /*!
+   * \brief Integrates exactly \p count input vectors per displayed row.
+   *
+   * \details
+   * Each row is the mean linear power of \p count consecutive input
+   * vectors (given in dB), converted back to dB, instead of a sample of
+   * the running average taken whenever the update timer fires. The row
+   * rate is thus tied to the input rate rather than to wall-clock time.
+   * If \p vec_rate (input vectors per second) is given, the time axis
+   * is labelled with the exact count / vec_rate seconds per row.
+   * A \p count of 0 returns to the timer-driven mode set by
+   * set_update_time().
+   */
+  virtual void set_integration(const int count, const double vec_rate = 0) = 0;
+
+  /*!
+   * \brief Same as set_integration() with the count that gives
+   * \p rows_per_sec displayed rows per second at \p vec_rate input
+   * vectors per second.
+   */
+  virtual void set_rows_per_second(const double rows_per_sec, const double vec_rate) = 0;
+  virtual int integration() const = 0;
+
+  /*!
+   * \brief Reduces each row to at most \p bins values before it is sent
+   * to the GUI.
+   *
+   * \details
+   * Only the part of the band visible in the plot is sent, pooled down
+   * to \p bins values with \p mode (max or mean), so transport and
+   * history memory scale with the display width instead of the vector
+   * size. Zooming in narrows the span, down to full resolution once it
+   * covers no more than \p bins bins; the history restarts whenever the
+   * span changes. \p bins of 0 or BIN_REDUCE_NONE sends full rows.
+   */
+  virtual void set_display_bins(const int bins, const bin_reduce_t mode = BIN_REDUCE_MAX) = 0;
+  virtual int display_bins() const = 0;
+
+  /*!
+   * \brief How pixels covering several bins or rows are drawn.
+   *
+   * \details
+   * With BIN_REDUCE_MAX or BIN_REDUCE_MEAN each pixel of a zoomed-out
+   * view shows the max or mean of every bin and row under it, so narrow
+   * carriers stay visible; the history keeps a pyramid of pooled levels
+   * per row for this, about one extra stored sample per bin. BIN_REDUCE_NONE
+   * (the default) shows the nearest bin.
+   */
+  virtual void set_zoom_aggregation(const bin_reduce_t mode) = 0;
+  virtual bin_reduce_t zoom_aggregation() const = 0;
+
+  /*!
+   * \brief Extends the history with \p tiers time-decimated tiers.
+   *
+   * \details
+   * Below the full-resolution rows, each tier holds as many lines
+   * again, every line pooling \p decimation lines of the tier above
+   * with \p mode (max or mean) as they scroll out of it. With 200 rows,
+   * 3 tiers and a decimation of 8 the display covers 200 * (1 + 8 + 64
+   * + 512) rows for four times the memory of the plain history. The
+   * time axis follows the seconds per line of every tier. Clears the
+   * history; 0 tiers restores the plain history.
+   */
+  virtual void set_history_tiers(const int tiers,
+                                 const int decimation,
+                                 const bin_reduce_t mode = BIN_REDUCE_MAX) = 0;
+  virtual int history_tiers() const = 0;
+
+  /*!
+   * \brief Sets the number of rows in the history of each connection.
+   *
+   * \details
+   * Every tier added by set_history_tiers() holds as many lines. The
+   * history is reallocated once and keeps its newest rows that still
+   * fit, so it can be resized while the flowgraph runs.
+   */
+  virtual void set_nrows(const int nrows) = 0;
+  virtual int nrows() const = 0;
+
+  /*!
+   * \brief Bytes held by the history of all connections, including
+   * the zoom aggregation pyramid and the history tiers.
+   */
+  virtual uint64_t history_bytes() const = 0;
+
+  /*!
+   * \brief Value of one of the sink's and display's event counters.
+   *
+   * \details
+   * Together they show whether the display keeps up: rows posted but
+   * neither taken in nor dropped are still queued (see queue_depth()),
+   * and a growing COUNTER_ROWS_DROPPED means the GUI falls behind.
+   */
+  virtual uint64_t counter(counter_t which) const = 0;
+  //! Rows posted by the sink that the display has not taken in yet
+  virtual uint64_t queue_depth() const = 0;
+
+  /*!
+   * \brief The \p percentile (0..1) of a sampled latency, in seconds.
+   *
+   * \details
+   * Latencies are kept in histograms of quarter-octave buckets, so the
+   * value is exact to about 19%. LATENCY_DISPLAY is the end-to-end time
+   * from a row being posted to the replot that shows it.
+   */
+  virtual double latency(latency_t which, double percentile = 0.5) const = 0;
+  virtual double mean_latency(latency_t which) const = 0;
+  virtual void reset_metrics() = 0;
+
+  //! Shows the counters and latencies in a corner of the plot
+  virtual void enable_metrics_overlay(bool en = true) = 0;
+
   virtual void set_frequency_range(const double centerfreq,
                                    const double bandwidth) = 0;
   virtual void set_intensity_range(const double min,
                                    const double max) = 0;
 
   virtual void set_update_time(double t) = 0;
+
+  /*!
+   * \brief Caps how often the display repaints, in frames per second.
+   *
+   * \details
+   * New rows, menu actions and setters only mark the display dirty; it
+   * is replotted once per frame period at most, however fast rows come
+   * in. 0 replots on every change. Defaults to 30.
+   */
+  virtual void set_max_fps(double fps) = 0;
+  virtual double max_fps() = 0;
+
   virtual void set_title(const std::string &title) = 0;
   virtual void set_time_title(const std::string &title) = 0;
   virtual void set_line_label(int which, const std::string &line) = 0;
@@ -101,9 +269,50 @@ public:
   virtual double line_alpha(int which) = 0;
   virtual int color_map(int which) = 0;
 
+  /*!
+   * \brief Draws all connections into a single image.
+   *
+   * \details
+   * By default every connection is rendered to its own image and Qwt
+   * blends the images with the line alphas, so the cost grows with each
+   * connection. COMPOSITE_BLEND builds one image in one pass over the
+   * pixels, each connection in its colour map blended over the first
+   * one with its line alpha; COMPOSITE_MAX colours every pixel by the
+   * highest intensity of all connections in the first colour map.
+   */
+  virtual void set_composite_mode(const composite_mode_t mode) = 0;
+  virtual composite_mode_t composite_mode() = 0;
+
+  /*!
+   * \brief Overlays the connections or stacks them in bands.
+   *
+   * \details
+   * With TILE_STACKED every connection is drawn opaque in its own band
+   * of the plot, captioned with its line label, and only as large as the
+   * band, so many receivers render at about the cost of one. The bands
+   * share the frequency axis and zoom; the time axis is hidden, as each
+   * band shows the whole history. Composited connections share the band
+   * of the first one.
+   */
+  virtual void set_tile_layout(const tile_layout_t layout) = 0;
+  virtual tile_layout_t tile_layout() = 0;
+
   virtual void set_size(int width, int height) = 0;
 
   virtual void auto_scale() = 0;
+
+  /*!
+   * \brief Keeps the intensity range on the noise floor and peak level.
+   *
+   * \details
+   * The sink tracks the 10th and 99.9th percentile of recent intensities
+   * of every connection in a decaying histogram; while enabled the
+   * display eases its intensity range towards them whenever they drift
+   * by more than a dB. Same as checking Auto Scale in the plot menu.
+   */
+  virtual void enable_auto_level(bool en = true) = 0;
+  virtual bool auto_level() const = 0;
+
   virtual double min_intensity(int which) = 0;
   virtual double max_intensity(int which) = 0;
 
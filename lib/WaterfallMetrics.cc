@@ -0,0 +1,121 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <spectrogram/WaterfallMetrics.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace gr::spectrogram;
+
+// Bucket b holds latencies below 2^((b + 1) / 4) - 1 microseconds
+static const double BUCKETS_PER_OCTAVE = 4.0;
+
+static unsigned int bucketOf(const double seconds)
+{
+    const double b = BUCKETS_PER_OCTAVE * log(1.0 + std::max(seconds, 0.0) * 1e6) / M_LN2;
+    return std::min(static_cast<unsigned int>(b), WaterfallMetrics::NUM_BUCKETS - 1);
+}
+
+static double bucketEdge(const unsigned int bucket)
+{
+    return (pow(2.0, (bucket + 1) / BUCKETS_PER_OCTAVE) - 1.0) * 1e-6;
+}
+
+WaterfallMetrics::WaterfallMetrics() { reset(); }
+
+void WaterfallMetrics::count(const int counter, const uint64_t n)
+{
+    d_counters[counter].fetch_add(n, boost::memory_order_relaxed);
+}
+
+uint64_t WaterfallMetrics::counter(const int counter) const
+{
+    return d_counters[counter].load(boost::memory_order_relaxed);
+}
+
+uint64_t WaterfallMetrics::queueDepth() const
+{
+    // Rendered rows are read first, so a row posted in between can only
+    // make the depth larger, never wrap it around. Rows waiting for a
+    // paced frame count as queued
+    const uint64_t rendered = counter(COUNTER_ROWS_RENDERED);
+    const uint64_t posted = counter(COUNTER_ROWS_POSTED);
+    return (posted > rendered) ? posted - rendered : 0;
+}
+
+void WaterfallMetrics::record(const int latency, const double seconds)
+{
+    d_buckets[latency][bucketOf(seconds)].fetch_add(1, boost::memory_order_relaxed);
+    d_samples[latency].fetch_add(1, boost::memory_order_relaxed);
+    d_total_ns[latency].fetch_add(static_cast<uint64_t>(std::max(seconds, 0.0) * 1e9),
+                                  boost::memory_order_relaxed);
+}
+
+void WaterfallMetrics::recordSince(const int latency, const gr::high_res_timer_type start)
+{
+    record(latency,
+           double(gr::high_res_timer_now() - start) / gr::high_res_timer_tps());
+}
+
+uint64_t WaterfallMetrics::samples(const int latency) const
+{
+    return d_samples[latency].load(boost::memory_order_relaxed);
+}
+
+double WaterfallMetrics::mean(const int latency) const
+{
+    const uint64_t n = samples(latency);
+    return n ? d_total_ns[latency].load(boost::memory_order_relaxed) * 1e-9 / n : 0.0;
+}
+
+double WaterfallMetrics::percentile(const int latency, const double p) const
+{
+    uint64_t total = 0;
+    for (unsigned int b = 0; b < NUM_BUCKETS; b++) {
+        total += d_buckets[latency][b].load(boost::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    const double target = std::max(0.0, std::min(p, 1.0)) * total;
+    uint64_t below = 0;
+    for (unsigned int b = 0; b < NUM_BUCKETS; b++) {
+        below += d_buckets[latency][b].load(boost::memory_order_relaxed);
+        if ((below > 0) && (below >= target)) {
+            return bucketEdge(b);
+        }
+    }
+    return bucketEdge(NUM_BUCKETS - 1);
+}
+
+void WaterfallMetrics::reset()
+{
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        d_counters[c].store(0, boost::memory_order_relaxed);
+    }
+    for (int l = 0; l < NUM_LATENCIES; l++) {
+        for (unsigned int b = 0; b < NUM_BUCKETS; b++) {
+            d_buckets[l][b].store(0, boost::memory_order_relaxed);
+        }
+        d_samples[l].store(0, boost::memory_order_relaxed);
+        d_total_ns[l].store(0, boost::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,170 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <spectrogram/WaterfallRenderWorker.h>
+#include <spectrogram/WaterfallVectorDisplayPlot.h>
+#include <spectrogram/WaterfallVectorUpdateEvents.h>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QTimerEvent>
+#include <algorithm>
+#include <cmath>
+
+WaterfallRenderWorker::Frame::Frame()
+    : rows(0), oldest(0), newest(0), noiseFloor(0.0), peakLevel(0.0)
+{
+}
+
+WaterfallRenderWorker::WaterfallRenderWorker(WaterfallVectorDisplayPlot* plot,
+                                             QObject* receiver)
+    : d_plot(plot),
+      d_receiver(receiver),
+      d_frame_posted(false),
+      d_last_render(0),
+      d_render_timer(0)
+{
+}
+
+WaterfallRenderWorker::~WaterfallRenderWorker() {}
+
+void WaterfallRenderWorker::setMetrics(WaterfallMetrics::sptr metrics)
+{
+    QMutexLocker lock(&d_mutex);
+    d_metrics = metrics;
+}
+
+bool WaterfallRenderWorker::takeFrame(Frame& frame)
+{
+    QMutexLocker lock(&d_mutex);
+    frame = d_frame;
+    d_frame = Frame();
+    d_frame_posted = false;
+    return frame.rows > 0;
+}
+
+void WaterfallRenderWorker::customEvent(QEvent* e)
+{
+    if (e->type() != WaterfallUpdateEvent::Type())
+        return;
+
+    WaterfallRowPool::sptr pool = ((WaterfallUpdateEvent*)e)->getRowPool();
+    WaterfallMetrics::sptr metrics;
+    {
+        QMutexLocker lock(&d_mutex);
+        metrics = d_metrics;
+    }
+
+    // Take every row queued since the last update
+    Frame& frame = d_unrendered;
+    {
+        QMutexLocker lock(d_plot->renderLock());
+
+        int slot;
+        pool->beginDrain();
+        while (pool->consume(slot)) {
+            const std::vector<float*>& dataPoints = pool->rows(slot);
+            if (d_plot->addRowData(dataPoints,
+                                   pool->rowLength(slot),
+                                   pool->spanLo(slot),
+                                   pool->spanHi(slot),
+                                   pool->droppedBefore(slot))) {
+                if (frame.rows++ == 0)
+                    frame.oldest = pool->timestamp(slot);
+                frame.newest = pool->timestamp(slot);
+
+                for (size_t i = 0; i < dataPoints.size(); i++) {
+                    const double floor = pool->noiseFloor(slot, i);
+                    const double peak = pool->peakLevel(slot, i);
+                    frame.noiseFloor = (i == 0) ? floor : std::min(frame.noiseFloor, floor);
+                    frame.peakLevel = (i == 0) ? peak : std::max(frame.peakLevel, peak);
+                }
+            }
+            pool->release(slot);
+        }
+    }
+
+    if (metrics)
+        metrics->count(gr::spectrogram::COUNTER_EVENTS_HANDLED);
+
+    renderIfDue();
+}
+
+void WaterfallRenderWorker::timerEvent(QTimerEvent* e)
+{
+    if (e->timerId() != d_render_timer)
+        return;
+
+    killTimer(d_render_timer);
+    d_render_timer = 0;
+    render();
+}
+
+void WaterfallRenderWorker::renderIfDue()
+{
+    if ((d_unrendered.rows == 0) || (d_render_timer != 0))
+        return;
+
+    double fps;
+    {
+        QMutexLocker lock(d_plot->renderLock());
+        fps = d_plot->getMaxFrameRate();
+    }
+
+    // Same pacing as the plot's replots: no sooner than one frame period
+    // after the last frame
+    const double since =
+        double(gr::high_res_timer_now() - d_last_render) / gr::high_res_timer_tps();
+    if ((fps <= 0) || (since >= 1.0 / fps)) {
+        render();
+        return;
+    }
+    d_render_timer = startTimer((int)ceil((1.0 / fps - since) * 1e3));
+}
+
+void WaterfallRenderWorker::render()
+{
+    if (d_unrendered.rows == 0)
+        return;
+
+    {
+        QMutexLocker lock(d_plot->renderLock());
+        d_plot->renderFrames();
+    }
+    d_last_render = gr::high_res_timer_now();
+
+    const Frame frame = d_unrendered;
+    d_unrendered = Frame();
+
+    // Frames the GUI has not shown yet are merged into one
+    QMutexLocker lock(&d_mutex);
+    if (d_metrics)
+        d_metrics->count(gr::spectrogram::COUNTER_ROWS_RENDERED, frame.rows);
+    if (d_frame.rows == 0)
+        d_frame.oldest = frame.oldest;
+    d_frame.rows += frame.rows;
+    d_frame.newest = frame.newest;
+    d_frame.noiseFloor = frame.noiseFloor;
+    d_frame.peakLevel = frame.peakLevel;
+
+    if (!d_frame_posted) {
+        d_frame_posted = true;
+        QCoreApplication::postEvent(d_receiver, new WaterfallFrameEvent());
+    }
+}
@@ -0,0 +1,154 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2019 viteo.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <spectrogram/WaterfallRowPool.h>
+#include <volk/volk.h>
+#include <cstring>
+
+WaterfallRowPool::WaterfallRowPool(const unsigned int numSlots,
+                                   const unsigned int numRows,
+                                   const uint64_t rowLength)
+    : d_slots(numSlots),
+      d_timestamps(numSlots, 0),
+      d_dropped_before(numSlots, 0),
+      d_lengths(numSlots, rowLength),
+      d_span_lo(numSlots, 0.0),
+      d_span_hi(numSlots, 1.0),
+      d_noise_floor(numSlots * numRows, 0.0f),
+      d_peak_level(numSlots * numRows, 0.0f),
+      d_num_rows(numRows),
+      d_row_length(rowLength),
+      d_free(numSlots),
+      d_ready(numSlots),
+      d_notify_pending(false),
+      d_pending_drops(0)
+{
+    const size_t alignment = volk_get_alignment();
+
+    for (unsigned int slot = 0; slot < numSlots; slot++) {
+        for (unsigned int row = 0; row < numRows; row++) {
+            float* buf = (float*)volk_malloc(d_row_length * sizeof(float), alignment);
+            memset(buf, 0, d_row_length * sizeof(float));
+            d_slots[slot].push_back(buf);
+        }
+        d_free.push(slot);
+    }
+}
+
+WaterfallRowPool::~WaterfallRowPool()
+{
+    for (size_t slot = 0; slot < d_slots.size(); slot++) {
+        for (size_t row = 0; row < d_slots[slot].size(); row++) {
+            volk_free(d_slots[slot][row]);
+        }
+    }
+}
+
+int WaterfallRowPool::acquire()
+{
+    int slot;
+    if (!d_free.pop(slot)) {
+        return -1;
+    }
+    return slot;
+}
+
+void WaterfallRowPool::markDropped() { d_pending_drops++; }
+
+void WaterfallRowPool::setRowStats(const int slot,
+                                   const unsigned int row,
+                                   const float noiseFloor,
+                                   const float peakLevel)
+{
+    const size_t index = slot * d_num_rows + row;
+    d_noise_floor[index] = noiseFloor;
+    d_peak_level[index] = peakLevel;
+}
+
+bool WaterfallRowPool::publish(const int slot,
+                               const gr::high_res_timer_type timestamp,
+                               const uint64_t length,
+                               const double spanLo,
+                               const double spanHi)
+{
+    d_timestamps[slot] = timestamp;
+    d_lengths[slot] = ((length > 0) && (length < d_row_length)) ? length : d_row_length;
+    d_span_lo[slot] = spanLo;
+    d_span_hi[slot] = spanHi;
+    d_dropped_before[slot] = d_pending_drops;
+    d_pending_drops = 0;
+
+    // The ready ring holds every slot, so this cannot fail
+    d_ready.push(slot);
+
+    return !d_notify_pending.exchange(true);
+}
+
+void WaterfallRowPool::beginDrain()
+{
+    // Clear before draining: anything published from now on either gets
+    // drained below or triggers a fresh notification.
+    d_notify_pending.store(false);
+}
+
+bool WaterfallRowPool::consume(int& slot) { return d_ready.pop(slot); }
+
+void WaterfallRowPool::release(const int slot)
+{
+    if ((slot < 0) || (slot >= static_cast<int>(d_slots.size()))) {
+        return;
+    }
+    d_free.push(slot);
+}
+
+const std::vector<float*>& WaterfallRowPool::rows(const int slot) const
+{
+    return d_slots[slot];
+}
+
+gr::high_res_timer_type WaterfallRowPool::timestamp(const int slot) const
+{
+    return d_timestamps[slot];
+}
+
+int WaterfallRowPool::droppedBefore(const int slot) const
+{
+    return d_dropped_before[slot];
+}
+
+uint64_t WaterfallRowPool::rowLength(const int slot) const { return d_lengths[slot]; }
+
+double WaterfallRowPool::spanLo(const int slot) const { return d_span_lo[slot]; }
+
+double WaterfallRowPool::spanHi(const int slot) const { return d_span_hi[slot]; }
+
+float WaterfallRowPool::noiseFloor(const int slot, const unsigned int row) const
+{
+    return d_noise_floor[slot * d_num_rows + row];
+}
+
+float WaterfallRowPool::peakLevel(const int slot, const unsigned int row) const
+{
+    return d_peak_level[slot * d_num_rows + row];
+}
+
+unsigned int WaterfallRowPool::numSlots() const { return d_slots.size(); }
+
+uint64_t WaterfallRowPool::rowLength() const { return d_row_length; }
@@ -21,9 +21,19 @@
 #include <spectrogram/WaterfallVectorDisplayForm.h>
 #include <QColorDialog>
 #include <QMessageBox>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
+// Headroom (dB) around the noise floor and the peak level when scaling
+static const double LEVEL_MARGIN_LOW = 5.0;
+static const double LEVEL_MARGIN_HIGH = 10.0;
+
+// Auto level ignores drift up to LEVEL_DEADBAND dB and otherwise moves
+// LEVEL_GAIN of the way to the new range per update
+static const double LEVEL_DEADBAND = 1.0;
+static const double LEVEL_GAIN = 0.25;
+
 WaterfallVectorDisplayForm::WaterfallVectorDisplayForm(int nplots, QWidget *parent)
     : DisplayForm(nplots, parent)
 {
@@ -43,10 +53,17 @@ WaterfallVectorDisplayForm::WaterfallVectorDisplayForm(int nplots, QWidget *pare
 
     d_min_val = 1000;
     d_max_val = -1000;
+    // Auto-level tracks from the plot's initial range until one is set
+    d_cur_min_val = getPlot()->getMinIntensity(0);
+    d_cur_max_val = getPlot()->getMaxIntensity(0);
 
     d_clicked = false;
     d_clicked_freq = 0;
+    d_span_lo = 0.0;
+    d_span_hi = 1.0;
     d_time_per_vec = 0;
+    d_metrics_label = NULL;
+    d_metrics_shown = 0;
     // We don't use the normal menus that are part of the displayform.
     // Clear them out to get rid of their resources.
     for (int i = 0; i < nplots; i++)
@@ -73,9 +90,10 @@ WaterfallVectorDisplayForm::WaterfallVectorDisplayForm(int nplots, QWidget *pare
         d_lines_menu[i]->addMenu(d_marker_alpha_menu[i]);
     }
 
-    // One scales once when clicked, so no on/off toggling
+    // Checked, the intensity range keeps following the tracked levels;
+    // DisplayForm sends the check state to autoScale(bool)
     d_autoscale_act->setText(tr("Auto Scale"));
-    d_autoscale_act->setCheckable(false);
+    d_autoscale_act->setCheckable(true);
 
     d_sizemenu = new VecSizeMenu(this);
     //d_menu->addMenu(d_sizemenu);
@@ -86,6 +104,12 @@ WaterfallVectorDisplayForm::WaterfallVectorDisplayForm(int nplots, QWidget *pare
     connect(
         d_avgmenu, SIGNAL(whichTrigger(float)), this, SLOT(setVecAverage(const float)));
 
+    // Only worth a menu with several inputs
+    d_layoutmenu = new TileLayoutMenu(this);
+    if (nplots > 1)
+        d_menu->addMenu(d_layoutmenu);
+    connect(d_layoutmenu, SIGNAL(whichTrigger(int)), this, SLOT(setTileLayout(const int)));
+
     PopupMenu *maxintmenu = new PopupMenu("Int. Max", this);
     d_menu->addAction(maxintmenu);
     connect(
@@ -98,10 +122,22 @@ WaterfallVectorDisplayForm::WaterfallVectorDisplayForm(int nplots, QWidget *pare
 
     Reset();
 
+    // Rows are added and rendered on a thread of their own; the GUI
+    // thread only replots finished frames
+    d_render_thread = new QThread(this);
+    d_render_worker = new WaterfallRenderWorker(getPlot(), this);
+    d_render_worker->moveToThread(d_render_thread);
+    d_render_thread->start();
+
     connect(d_display_plot,
             SIGNAL(plotPointSelected(const QPointF)),
             this,
             SLOT(onPlotPointSelected(const QPointF)));
+
+    connect(d_display_plot,
+            SIGNAL(visibleSpanChanged(double, double)),
+            this,
+            SLOT(onVisibleSpanChanged(double, double)));
 }
 
 WaterfallVectorDisplayForm::~WaterfallVectorDisplayForm()
@@ -111,6 +147,11 @@ WaterfallVectorDisplayForm::~WaterfallVectorDisplayForm()
     // Don't worry about deleting Display Plots - they are deleted when parents are
     // deleted
     delete d_int_validator;
+
+    // The worker renders into the plot, so it stops before the plot goes
+    d_render_thread->quit();
+    d_render_thread->wait();
+    delete d_render_worker;
 }
 
 WaterfallVectorDisplayPlot *WaterfallVectorDisplayForm::getPlot()
@@ -118,31 +159,40 @@ WaterfallVectorDisplayPlot *WaterfallVectorDisplayForm::getPlot()
     return ((WaterfallVectorDisplayPlot *)d_display_plot);
 }
 
-void WaterfallVectorDisplayForm::newData(const QEvent *updateEvent)
+WaterfallRenderWorker *WaterfallVectorDisplayForm::getRenderWorker()
 {
-    WaterfallUpdateEvent *event = (WaterfallUpdateEvent *)updateEvent;
-    const std::vector<double *> dataPoints = event->getPoints();
-    const uint64_t numDataPoints = event->getNumDataPoints();
-    const gr::high_res_timer_type dataTimestamp = event->getDataTimestamp();
+    return d_render_worker;
+}
 
-    for (size_t i = 0; i < dataPoints.size(); i++)
-    {
-        double *min_val =
-            std::min_element(&dataPoints[i][0], &dataPoints[i][numDataPoints - 1]);
-        double *max_val =
-            std::max_element(&dataPoints[i][0], &dataPoints[i][numDataPoints - 1]);
-        if (*min_val < d_min_val)
-            d_min_val = *min_val;
-        if (*max_val > d_max_val)
-            d_max_val = *max_val;
-    }
+void WaterfallVectorDisplayForm::newData(const QEvent *frameEvent)
+{
+    // The render thread already added and drew the rows; replotting
+    // shows its frame
+    WaterfallRenderWorker::Frame frame;
+    if (!d_render_worker->takeFrame(frame))
+        return;
+
+    // Autoscale follows the levels the sink tracked up to the newest
+    // row: the lowest noise floor and the highest peak of all plots
+    d_min_val = frame.noiseFloor;
+    d_max_val = frame.peakLevel;
+
+    getPlot()->updateTimeAxis(d_time_per_vec, frame.newest);
+
+    if (d_autoscale_state)
+        _trackLevels();
+
+    // Frames arriving faster than the frame rate share one replot
+    getPlot()->addPendingRows(frame.oldest);
+    getPlot()->replot();
 
-    getPlot()->plotNewData(dataPoints, numDataPoints, d_time_per_vec, dataTimestamp, 0);
+    if (d_metrics_label && d_metrics_label->isVisible())
+        _updateMetricsOverlay();
 }
 
 void WaterfallVectorDisplayForm::customEvent(QEvent *e)
 {
-    if (e->type() == WaterfallUpdateEvent::Type())
+    if (e->type() == WaterfallFrameEvent::Type())
     {
         newData(e);
     }
@@ -227,10 +277,6 @@ void WaterfallVectorDisplayForm::setAlpha(int which, int alpha)
 void WaterfallVectorDisplayForm::setIntensityRange(const double minIntensity,
                                                    const double maxIntensity)
 {
-    // reset max and min values
-    d_min_val = 1000;
-    d_max_val = -1000;
-
     d_cur_min_val = minIntensity;
     d_cur_max_val = maxIntensity;
     getPlot()->setIntensityRange(minIntensity, maxIntensity);
@@ -253,14 +299,194 @@ void WaterfallVectorDisplayForm::setMinIntensity(const QString &m)
 
 void WaterfallVectorDisplayForm::autoScale(bool en)
 {
-    double min_int = d_min_val - 5;
-    double max_int = d_max_val + 10;
+    // Checks the menu action and rescales the plot, which only the GUI
+    // thread may touch
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(
+            this, "autoScale", Qt::QueuedConnection, Q_ARG(bool, en));
+        return;
+    }
+    d_autoscale_state = en;
+    d_autoscale_act->setChecked(en);
 
-    setIntensityRange(min_int, max_int);
+    // Nothing to scale to before the first row
+    if (d_max_val < d_min_val)
+        return;
+
+    setIntensityRange(d_min_val - LEVEL_MARGIN_LOW, d_max_val + LEVEL_MARGIN_HIGH);
+}
+
+bool WaterfallVectorDisplayForm::getAutoLevel() const { return d_autoscale_state; }
+
+void WaterfallVectorDisplayForm::setMaxFrameRate(const double fps)
+{
+    getPlot()->setMaxFrameRate(fps);
+}
+
+double WaterfallVectorDisplayForm::getMaxFrameRate() { return getPlot()->getMaxFrameRate(); }
+
+void WaterfallVectorDisplayForm::setCompositeMode(const int mode)
+{
+    // Hides the composited items and retiles the axes, which only the GUI
+    // thread may touch
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(
+            this, "setCompositeMode", Qt::QueuedConnection, Q_ARG(int, mode));
+        return;
+    }
+    getPlot()->setCompositeMode(mode);
+}
+
+int WaterfallVectorDisplayForm::getCompositeMode() { return getPlot()->getCompositeMode(); }
+
+void WaterfallVectorDisplayForm::setTileLayout(const int layout)
+{
+    // Retiles the axes, the zoomer and the captions, which only the GUI
+    // thread may touch
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(
+            this, "setTileLayout", Qt::QueuedConnection, Q_ARG(int, layout));
+        return;
+    }
+    getPlot()->setTileLayout(layout);
+    d_layoutmenu->getAction(layout)->setChecked(true);
+}
+
+int WaterfallVectorDisplayForm::getTileLayout() { return getPlot()->getTileLayout(); }
+
+void WaterfallVectorDisplayForm::setMetrics(WaterfallMetrics::sptr metrics)
+{
+    d_metrics = metrics;
+    getPlot()->setMetrics(metrics);
+    d_render_worker->setMetrics(metrics);
+}
+
+void WaterfallVectorDisplayForm::setMetricsOverlay(const bool en)
+{
+    if (d_metrics_label == NULL)
+    {
+        if (!en)
+            return;
+
+        d_metrics_label = new QLabel(getPlot()->canvas());
+        d_metrics_label->setStyleSheet(
+            "QLabel { background-color: rgba(0, 0, 0, 160); color: white; padding: 4px; }");
+        d_metrics_label->setFont(QFont("Monospace", 8));
+        d_metrics_label->move(8, 8);
+    }
+
+    d_metrics_label->setVisible(en);
+    if (en)
+    {
+        d_metrics_shown = 0;
+        _updateMetricsOverlay();
+    }
+}
+
+void WaterfallVectorDisplayForm::_updateMetricsOverlay()
+{
+    using namespace gr::spectrogram;
+
+    // Twice a second is plenty for reading, and keeps the label cheap
+    const gr::high_res_timer_type now = gr::high_res_timer_now();
+    if (!d_metrics || (now - d_metrics_shown < gr::high_res_timer_tps() / 2))
+        return;
+    d_metrics_shown = now;
+
+    const double ms = 1e3;
+    d_metrics_label->setText(
+        QString("rows   %1 posted  %2 drawn  %3 dropped  %4 queued\n"
+                "render %5 / %6 ms   replot %7 / %8 ms\n"
+                "delay  %9 / %10 ms  (p50 / p99)")
+            .arg((qulonglong)d_metrics->counter(COUNTER_ROWS_POSTED))
+            .arg((qulonglong)d_metrics->counter(COUNTER_ROWS_RENDERED))
+            .arg((qulonglong)d_metrics->counter(COUNTER_ROWS_DROPPED))
+            .arg((qulonglong)d_metrics->queueDepth())
+            .arg(d_metrics->percentile(LATENCY_RENDER, 0.5) * ms, 0, 'f', 1)
+            .arg(d_metrics->percentile(LATENCY_RENDER, 0.99) * ms, 0, 'f', 1)
+            .arg(d_metrics->percentile(LATENCY_REPLOT, 0.5) * ms, 0, 'f', 1)
+            .arg(d_metrics->percentile(LATENCY_REPLOT, 0.99) * ms, 0, 'f', 1)
+            .arg(d_metrics->percentile(LATENCY_DISPLAY, 0.5) * ms, 0, 'f', 1)
+            .arg(d_metrics->percentile(LATENCY_DISPLAY, 0.99) * ms, 0, 'f', 1));
+    d_metrics_label->adjustSize();
+}
+
+void WaterfallVectorDisplayForm::_trackLevels()
+{
+    if (d_max_val < d_min_val)
+        return;
+
+    // Every new range repaints the whole history, so only drift of more
+    // than LEVEL_DEADBAND is followed, easing part of the way each time
+    const double target_min = d_min_val - LEVEL_MARGIN_LOW;
+    const double target_max = d_max_val + LEVEL_MARGIN_HIGH;
+    if ((fabs(target_min - d_cur_min_val) <= LEVEL_DEADBAND) &&
+        (fabs(target_max - d_cur_max_val) <= LEVEL_DEADBAND))
+        return;
+
+    setIntensityRange(d_cur_min_val + LEVEL_GAIN * (target_min - d_cur_min_val),
+                      d_cur_max_val + LEVEL_GAIN * (target_max - d_cur_max_val));
 }
 
 void WaterfallVectorDisplayForm::clearData() { getPlot()->clearData(); }
 
+void WaterfallVectorDisplayForm::setStorageType(const int type,
+                                                const double offset,
+                                                const double scale)
+{
+    getPlot()->setStorageType(type, offset, scale);
+}
+
+void WaterfallVectorDisplayForm::setAggregation(const int mode)
+{
+    getPlot()->setAggregation(mode);
+}
+
+int WaterfallVectorDisplayForm::getAggregation()
+{
+    return getPlot()->getAggregation();
+}
+
+void WaterfallVectorDisplayForm::setHistoryTiers(const int tiers,
+                                                 const int decimation,
+                                                 const int mode)
+{
+    // Rescales the time axis and the zoomer, which only the GUI thread may
+    // touch
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this,
+                                  "setHistoryTiers",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, tiers),
+                                  Q_ARG(int, decimation),
+                                  Q_ARG(int, mode));
+        return;
+    }
+    getPlot()->setHistoryTiers(tiers, decimation, mode);
+}
+
+void WaterfallVectorDisplayForm::setNumRows(const int nrows)
+{
+    // Reallocates the history and resets the zoomer, which only the GUI
+    // thread may touch
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(
+            this, "setNumRows", Qt::QueuedConnection, Q_ARG(int, nrows));
+        return;
+    }
+    getPlot()->setNumRows(nrows);
+}
+
+uint64_t WaterfallVectorDisplayForm::getHistoryMemory()
+{
+    return getPlot()->getHistoryMemory();
+}
+
 void WaterfallVectorDisplayForm::onPlotPointSelected(const QPointF p)
 {
     d_clicked = true;
@@ -285,6 +511,20 @@ void WaterfallVectorDisplayForm::setTimeTitle(const std::string title)
     getPlot()->setAxisTitle(QwtPlot::yLeft, title.c_str());
 }
 
+void WaterfallVectorDisplayForm::onVisibleSpanChanged(double spanLo, double spanHi)
+{
+    QMutexLocker lock(&d_span_lock);
+    d_span_lo = spanLo;
+    d_span_hi = spanHi;
+}
+
+void WaterfallVectorDisplayForm::getVisibleSpan(double &spanLo, double &spanHi) const
+{
+    QMutexLocker lock(&d_span_lock);
+    spanLo = d_span_lo;
+    spanHi = d_span_hi;
+}
+
 float WaterfallVectorDisplayForm::getClickedFreq() const { return d_clicked_freq; }
 
 void WaterfallVectorDisplayForm::setTimePerVec(double t) { d_time_per_vec = t; }
@@ -23,12 +23,19 @@
 
 #include <spectrogram/WaterfallVectorDisplayPlot.h>
 
+#include <spectrogram/composite_mode.h>
 #include <spectrogram/spectrogram_types.h>
+#include <spectrogram/tile_layout.h>
 #include <qwt_color_map.h>
 #include <qwt_legend.h>
 #include <qwt_plot_layout.h>
 #include <qwt_scale_draw.h>
+#include <qwt_scale_div.h>
+#include <qwt_scale_widget.h>
 #include <QColor>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
 #include <iostream>
 
 #if QWT_VERSION < 0x060100
@@ -55,7 +62,7 @@ public:
 
     virtual QwtText label(double value) const
     {
-        double secs = double(value * getSecondsPerLine());
+        double secs = getSecondsAt(value);
         return QwtText(QString("").sprintf("%u", (uint)(secs*10)));
     }
 
@@ -85,7 +92,8 @@ public:
 #endif /* QWT_VERSION < 0x060100 */
         : QwtPlotZoomer(canvas),
           TimeScaleData(),
-          FreqOffsetAndPrecisionClass(freqPrecision)
+          FreqOffsetAndPrecisionClass(freqPrecision),
+          d_tiles(1)
     {
         setTrackerMode(QwtPicker::AlwaysOn);
     }
@@ -96,12 +104,45 @@ public:
 
     void setUnitType(const std::string &type) { d_unitType = type; }
 
+    // Number of bands the inputs are stacked in
+    void setTiles(const int tiles) { d_tiles = std::max(tiles, 1); }
+
 protected:
+    // Every band squeezes the whole canvas; selections and the tracker
+    // are mapped back through the band they start in
+    int tileAt(const int y) const
+    {
+        const QRect rect = canvas()->contentsRect();
+        const int tile = (y - rect.top()) * d_tiles / std::max(rect.height(), 1);
+        return std::min(std::max(tile, 0), d_tiles - 1);
+    }
+
+    QPoint untile(const QPoint &p, const int tile) const
+    {
+        if (d_tiles <= 1)
+            return p;
+        const QRect rect = canvas()->contentsRect();
+        const double height = double(rect.height()) / d_tiles;
+        const double y = std::min(std::max(p.y() - rect.top() - tile * height, 0.0), height);
+        return QPoint(p.x(), rect.top() + qRound(y * d_tiles));
+    }
+
+    virtual bool accept(QPolygon &pa) const
+    {
+        if (d_tiles > 1 && pa.count() > 0)
+        {
+            const int tile = tileAt(pa[0].y());
+            for (int i = 0; i < pa.count(); i++)
+                pa[i] = untile(pa[i], tile);
+        }
+        return QwtPlotZoomer::accept(pa);
+    }
+
     using QwtPlotZoomer::trackerText;
     virtual QwtText trackerText(QPoint const &p) const
     {
-        QwtDoublePoint dp = QwtPlotZoomer::invTransform(p);
-        double secs = double(dp.y() * getSecondsPerLine());
+        QwtDoublePoint dp = QwtPlotZoomer::invTransform(untile(p, tileAt(p.y())));
+        double secs = getSecondsAt(dp.y());
         QwtText t(QString("%1 %2, %3 s")
                       .arg(dp.x(), 0, 'f', getFrequencyPrecision())
                       .arg(d_unitType.c_str())
@@ -111,22 +152,44 @@ protected:
 
 private:
     std::string d_unitType;
+    int d_tiles;
 };
 
 /*********************************************************************
  * Main waterfall plot widget
  *********************************************************************/
 WaterfallVectorDisplayPlot::WaterfallVectorDisplayPlot(int nplots, QWidget *parent)
-    : DisplayPlot(nplots, parent)
+    : DisplayPlot(nplots, parent), d_render_lock(QMutex::Recursive)
 {
+    // Every replot() below goes through the timer
+    d_max_fps = 30.0;
+    d_replot_pending = false;
+    d_last_replot = 0;
+    d_oldest_pending = 0;
+    d_replot_timer = new QTimer(this);
+    d_replot_timer->setSingleShot(true);
+    connect(d_replot_timer, SIGNAL(timeout()), this, SLOT(flushReplot()));
+
     d_zoomer = NULL; // need this for proper init
     d_start_frequency = -1;
     d_stop_frequency = 1;
+    d_span_lo = 0.0;
+    d_span_hi = 1.0;
 
     resize(parent->width(), parent->height());
     d_numPoints = 0;
     d_legend_enabled = true;
     d_nrows = 200;
+    d_storage_type = gr::spectrogram::STORAGE_FLOAT;
+    d_storage_offset = -150.0;
+    d_storage_scale = 0.0;
+    d_aggregation = gr::spectrogram::BIN_REDUCE_NONE;
+    d_history_tiers = 0;
+    d_tier_decimation = 1;
+    d_tier_reduce = gr::spectrogram::BIN_REDUCE_MAX;
+    d_composite_mode = gr::spectrogram::COMPOSITE_NONE;
+    d_tile_layout = gr::spectrogram::TILE_OVERLAY;
+    d_tiles = 1;
     d_color_bar_title_font_size = 18;
 
     setAxisTitle(QwtPlot::xBottom, "Frequency (Hz)");
@@ -137,15 +200,21 @@ WaterfallVectorDisplayPlot::WaterfallVectorDisplayPlot(int nplots, QWidget *pare
 
     for (int i = 0; i < d_nplots; i++)
     {
-        d_data.push_back(
-            new WaterfallVectorData(d_start_frequency, d_stop_frequency, d_numPoints, d_nrows));
-
+        d_data.push_back(new WaterfallVectorData(d_start_frequency,
+                                                 d_stop_frequency,
+                                                 d_numPoints,
+                                                 d_nrows,
+                                                 d_storage_type,
+                                                 d_storage_offset,
+                                                 d_storage_scale));
+
+        // The title captions the input when the inputs are stacked
 #if QWT_VERSION < 0x060000
-        d_spectrogram.push_back(new PlotWaterfall(d_data[i], "Spectrogram"));
+        d_spectrogram.push_back(new PlotWaterfall(d_data[i], QString("Data %1").arg(i)));
 
 #else
-        d_spectrogram.push_back(new QwtPlotSpectrogram("Spectrogram"));
-        d_spectrogram[i]->setData(d_data[i]);
+        d_spectrogram.push_back(
+            new WaterfallSpectrogram(d_data[i], QString("Data %1").arg(i)));
         d_spectrogram[i]->setDisplayMode(QwtPlotSpectrogram::ImageMode, true);
         d_spectrogram[i]->setColorMap(new ColorMap_MultiColor());
 #endif
@@ -156,10 +225,16 @@ WaterfallVectorDisplayPlot::WaterfallVectorDisplayPlot(int nplots, QWidget *pare
 
         d_spectrogram[i]->attach(this);
 
+        // The render worker draws the frames; full redraws (zoom, resize,
+        // colour map) use every core
+        d_spectrogram[i]->setRenderLock(&d_render_lock);
+        d_spectrogram[i]->setRenderThreadCount(0);
+
         d_intensity_color_map_type.push_back(INTENSITY_COLOR_MAP_TYPE_MULTI_COLOR);
         setIntensityColorMapType(
             i, d_intensity_color_map_type[i], QColor("white"), QColor("white"));
 
+        d_alpha.push_back(255);
         setAlpha(i, 255 / d_nplots);
     }
 
@@ -185,20 +260,27 @@ WaterfallVectorDisplayPlot::WaterfallVectorDisplayPlot(int nplots, QWidget *pare
     _updateIntensityRangeDisplay();
 
     d_xaxis_multiplier = 1;
+
+    // Report zooming and panning so the sink can send only what is visible
+    connect(axisWidget(QwtPlot::xBottom),
+            SIGNAL(scaleDivChanged()),
+            this,
+            SLOT(onXScaleDivChanged()));
 }
 
 WaterfallVectorDisplayPlot::~WaterfallVectorDisplayPlot() {}
 
 void WaterfallVectorDisplayPlot::resetAxis()
 {
-    for (int i = 0; i < d_nplots; i++)
-    {
-        d_data[i]->resizeData(d_start_frequency, d_stop_frequency, d_numPoints, d_nrows);
-        d_data[i]->reset();
-    }
+    QMutexLocker lock(&d_render_lock);
+    _resizeData();
 
     setAxisScale(QwtPlot::xBottom, d_start_frequency, d_stop_frequency);
+    _resetZoom();
+}
 
+void WaterfallVectorDisplayPlot::_resetZoom()
+{
     // Load up the new base zoom settings
     QwtDoubleRect zbase = d_zoomer->zoomBase();
     d_zoomer->zoom(zbase);
@@ -207,11 +289,52 @@ void WaterfallVectorDisplayPlot::resetAxis()
     d_zoomer->zoom(0);
 }
 
+void WaterfallVectorDisplayPlot::_resizeData()
+{
+    // The rows may only cover part of the band when the sink reduces
+    // them to the visible span
+    const double width = d_stop_frequency - d_start_frequency;
+    const double start = d_start_frequency + d_span_lo * width;
+    const double stop = d_start_frequency + d_span_hi * width;
+
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->resizeData(start, stop, d_numPoints, d_nrows);
+        d_data[i]->reset();
+        d_spectrogram[i]->invalidateImage();
+    }
+}
+
+void WaterfallVectorDisplayPlot::_remapData()
+{
+    const double width = d_stop_frequency - d_start_frequency;
+    const double start = d_start_frequency + d_span_lo * width;
+    const double stop = d_start_frequency + d_span_hi * width;
+
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->remapData(start, stop, d_numPoints);
+        d_spectrogram[i]->invalidateImage();
+    }
+}
+
+void WaterfallVectorDisplayPlot::onXScaleDivChanged()
+{
+    const double width = d_stop_frequency - d_start_frequency;
+    if (width <= 0)
+        return;
+
+    const QwtScaleDiv &div = axisScaleDiv(QwtPlot::xBottom);
+    emit visibleSpanChanged((div.lowerBound() - d_start_frequency) / width,
+                            (div.upperBound() - d_start_frequency) / width);
+}
+
 void WaterfallVectorDisplayPlot::setFrequencyRange(const double centerfreq,
                                              const double bandwidth,
                                              const double units,
                                              const std::string &strunits)
 {
+    QMutexLocker lock(&d_render_lock);
     double startFreq = (centerfreq - bandwidth / 2.0f) / units;
     double stopFreq = (centerfreq + bandwidth / 2.0f) / units;
 
@@ -249,95 +372,63 @@ double WaterfallVectorDisplayPlot::getStartFrequency() const { return d_start_fr
 
 double WaterfallVectorDisplayPlot::getStopFrequency() const { return d_stop_frequency; }
 
-void WaterfallVectorDisplayPlot::plotNewData(const std::vector<double *> dataPoints,
-                                       const int64_t numDataPoints,
-                                       const double timePerVec,
-                                       const gr::high_res_timer_type timestamp,
-                                       const int droppedFrames)
+bool WaterfallVectorDisplayPlot::addRowData(const std::vector<float *> &dataPoints,
+                                            const int64_t numDataPoints,
+                                            const double spanLo,
+                                            const double spanHi,
+                                            const int droppedFrames)
 {
-    int64_t _in_index = 0;
-
-    if (!d_stop)
+    QMutexLocker lock(&d_render_lock);
+    if (d_stop || numDataPoints <= 0)
     {
-        if (numDataPoints > 0 && timestamp == 0)
-        {
-            d_numPoints = numDataPoints / d_nrows;
-            resetAxis();
-
-            for (int i = 0; i < d_nplots; i++)
-            {
-                d_data[i]->setSpectrumDataBuffer(dataPoints[i]);
-                d_data[i]->setNumLinesToUpdate(0);
-                d_spectrogram[i]->invalidateCache();
-                d_spectrogram[i]->itemChanged();
-            }
-
-            QwtTimeScaleDraw *timeScale =
-                (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
-            timeScale->setSecondsPerLine(timePerVec);
-            timeScale->setZeroTime(timestamp);
-            timeScale->initiateUpdate();
-
-            ((WaterfallZoomer *)d_zoomer)->setSecondsPerLine(timePerVec);
-            ((WaterfallZoomer *)d_zoomer)->setZeroTime(timestamp);
-            replot();
-        }
-
-        else if (numDataPoints > 0)
-        {
-            if (numDataPoints != d_numPoints)
-            {
-                d_numPoints = numDataPoints;
-                resetAxis();
-
-                for (int i = 0; i < d_nplots; i++)
-                {
-                    d_spectrogram[i]->invalidateCache();
-                    d_spectrogram[i]->itemChanged();
-                }
-
-                if (isVisible())
-                {
-                    replot();
-                }
-            }
-
-            QwtTimeScaleDraw *timeScale =
-                (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
-            timeScale->setSecondsPerLine(timePerVec);
-            timeScale->setZeroTime(timestamp);
+        return false;
+    }
 
-            ((WaterfallZoomer *)d_zoomer)->setSecondsPerLine(timePerVec);
-            ((WaterfallZoomer *)d_zoomer)->setZeroTime(timestamp);
+    // The sink changed the row length or the span it reduces to; the
+    // rows already shown are resampled so zooming keeps the history
+    if ((numDataPoints != d_numPoints) || (spanLo != d_span_lo) || (spanHi != d_span_hi))
+    {
+        d_numPoints = numDataPoints;
+        d_span_lo = spanLo;
+        d_span_hi = spanHi;
+        _remapData();
+    }
 
-            for (int i = 0; i < d_nplots; i++)
-            {
-                d_data[i]->addVecData(
-                    &(dataPoints[i][_in_index]), numDataPoints, droppedFrames);
-                d_data[i]->incrementNumLinesToUpdate();
-                d_spectrogram[i]->invalidateCache();
-                d_spectrogram[i]->itemChanged();
-            }
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->addVecData(dataPoints[i], numDataPoints, droppedFrames);
+    }
+    return true;
+}
 
-            replot();
-        }
+void WaterfallVectorDisplayPlot::renderFrames()
+{
+    QMutexLocker lock(&d_render_lock);
+    for (int i = 0; i < d_nplots; i++)
+    {
+        // Composited inputs are drawn by the first item
+        if (d_spectrogram[i]->isVisible())
+            d_spectrogram[i]->renderFrame();
     }
 }
 
-void WaterfallVectorDisplayPlot::plotNewData(const double *dataPoints,
-                                       const int64_t numDataPoints,
-                                       const double timePerVec,
-                                       const gr::high_res_timer_type timestamp,
-                                       const int droppedFrames)
+QMutex *WaterfallVectorDisplayPlot::renderLock() { return &d_render_lock; }
+
+void WaterfallVectorDisplayPlot::updateTimeAxis(const double timePerVec,
+                                                const gr::high_res_timer_type timestamp)
 {
-    std::vector<double *> vecDataPoints;
-    vecDataPoints.push_back((double *)dataPoints);
-    plotNewData(vecDataPoints, numDataPoints, timePerVec, timestamp, droppedFrames);
+    QwtTimeScaleDraw *timeScale = (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
+    timeScale->setSecondsPerLine(timePerVec);
+    timeScale->setZeroTime(timestamp);
+
+    ((WaterfallZoomer *)d_zoomer)->setSecondsPerLine(timePerVec);
+    ((WaterfallZoomer *)d_zoomer)->setZeroTime(timestamp);
 }
 
 void WaterfallVectorDisplayPlot::setIntensityRange(const double minIntensity,
                                              const double maxIntensity)
 {
+    QMutexLocker lock(&d_render_lock);
     for (int i = 0; i < d_nplots; i++)
     {
 #if QWT_VERSION < 0x060000
@@ -387,6 +478,37 @@ void WaterfallVectorDisplayPlot::setColorMapTitleFontSize(int tfs)
 
 void WaterfallVectorDisplayPlot::replot()
 {
+    // Setters called from the flowgraph's threads replot too; the timer
+    // and the pending flag belong to the GUI thread
+    if (QThread::currentThread() != thread())
+    {
+        QMetaObject::invokeMethod(this, "replot", Qt::QueuedConnection);
+        return;
+    }
+
+    if (d_replot_pending)
+        return;
+
+    if (d_max_fps <= 0)
+    {
+        flushReplot();
+        return;
+    }
+
+    // Flush right after the requests queued in this pass of the event
+    // loop, but no sooner than one frame period after the last replot
+    const double period = 1.0 / d_max_fps;
+    const double since =
+        double(gr::high_res_timer_now() - d_last_replot) / gr::high_res_timer_tps();
+    d_replot_timer->start((since >= period) ? 0 : (int)ceil((period - since) * 1e3));
+    d_replot_pending = true;
+}
+
+void WaterfallVectorDisplayPlot::flushReplot()
+{
+    d_replot_pending = false;
+    d_last_replot = gr::high_res_timer_now();
+
     QwtTimeScaleDraw *timeScale = (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
     timeScale->initiateUpdate();
 
@@ -412,13 +534,38 @@ void WaterfallVectorDisplayPlot::replot()
     }
 
     QwtPlot::replot();
+
+    if (d_metrics)
+    {
+        d_metrics->recordSince(gr::spectrogram::LATENCY_REPLOT, d_last_replot);
+        if (d_oldest_pending > 0)
+            d_metrics->recordSince(gr::spectrogram::LATENCY_DISPLAY, d_oldest_pending);
+    }
+    d_oldest_pending = 0;
+}
+
+void WaterfallVectorDisplayPlot::setMaxFrameRate(const double fps)
+{
+    // Also read by the render worker
+    QMutexLocker lock(&d_render_lock);
+    d_max_fps = std::max(fps, 0.0);
+}
+
+double WaterfallVectorDisplayPlot::getMaxFrameRate() const { return d_max_fps; }
+
+void WaterfallVectorDisplayPlot::addPendingRows(const gr::high_res_timer_type timestamp)
+{
+    if ((d_oldest_pending == 0) || (timestamp < d_oldest_pending))
+        d_oldest_pending = timestamp;
 }
 
 void WaterfallVectorDisplayPlot::clearData()
 {
+    QMutexLocker lock(&d_render_lock);
     for (int i = 0; i < d_nplots; i++)
     {
         d_data[i]->reset();
+        d_spectrogram[i]->invalidateImage();
     }
 }
 
@@ -432,6 +579,7 @@ void WaterfallVectorDisplayPlot::setIntensityColorMapType(const int which,
                                                     const QColor lowColor,
                                                     const QColor highColor)
 {
+    QMutexLocker lock(&d_render_lock);
     if ((d_intensity_color_map_type[which] != newType) ||
         ((newType == INTENSITY_COLOR_MAP_TYPE_USER_DEFINED) &&
          (lowColor.isValid() && highColor.isValid())))
@@ -522,6 +670,9 @@ void WaterfallVectorDisplayPlot::setIntensityColorMapType(const int which,
             break;
         }
 
+        d_spectrogram[which]->invalidateImage();
+        if (d_composite_mode != gr::spectrogram::COMPOSITE_NONE)
+            d_spectrogram[0]->invalidateImage();
         _updateIntensityRangeDisplay();
     }
 }
@@ -559,15 +710,175 @@ const QColor WaterfallVectorDisplayPlot::getUserDefinedHighIntensityColor() cons
     return d_user_defined_high_intensity_color;
 }
 
-int WaterfallVectorDisplayPlot::getAlpha(int which) { return d_spectrogram[which]->alpha(); }
+int WaterfallVectorDisplayPlot::getAlpha(int which) { return d_alpha[which]; }
 
 void WaterfallVectorDisplayPlot::setAlpha(int which, int alpha)
 {
-    d_spectrogram[which]->setAlpha(alpha);
+    QMutexLocker lock(&d_render_lock);
+    d_alpha[which] = alpha;
+    // Stacked inputs do not overlap and are drawn opaque
+    if (d_tiles == 1)
+        d_spectrogram[which]->setAlpha(alpha);
+    if (d_composite_mode != gr::spectrogram::COMPOSITE_NONE)
+        d_spectrogram[0]->invalidateImage();
+}
+
+void WaterfallVectorDisplayPlot::setLineLabel(int which, QString label)
+{
+    DisplayPlot::setLineLabel(which, label);
+    d_spectrogram[which]->setTitle(label);
 }
 
 int WaterfallVectorDisplayPlot::getNumRows() const { return d_nrows; }
 
+uint64_t WaterfallVectorDisplayPlot::getHistoryMemory() const
+{
+    QMutexLocker lock(&d_render_lock);
+    uint64_t bytes = 0;
+    for (int i = 0; i < d_nplots; i++)
+    {
+        bytes += d_data[i]->getMemoryUsage();
+    }
+    return bytes;
+}
+
+void WaterfallVectorDisplayPlot::setStorageType(const int type,
+                                                const double offset,
+                                                const double scale)
+{
+    QMutexLocker lock(&d_render_lock);
+    d_storage_type = type;
+    d_storage_offset = offset;
+    d_storage_scale = scale;
+
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->setStorageType(d_storage_type, d_storage_offset, d_storage_scale);
+        d_spectrogram[i]->invalidateCache();
+        d_spectrogram[i]->itemChanged();
+    }
+}
+
+int WaterfallVectorDisplayPlot::getStorageType() const { return d_storage_type; }
+
+void WaterfallVectorDisplayPlot::setAggregation(const int mode)
+{
+    QMutexLocker lock(&d_render_lock);
+    d_aggregation = mode;
+
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->setAggregation(d_aggregation);
+        d_spectrogram[i]->invalidateImage();
+    }
+    replot();
+}
+
+int WaterfallVectorDisplayPlot::getAggregation() const { return d_aggregation; }
+
+void WaterfallVectorDisplayPlot::setHistoryTiers(const int tiers,
+                                                 const int decimation,
+                                                 const int mode)
+{
+    {
+        // Only the data swap races the render thread
+        QMutexLocker lock(&d_render_lock);
+        d_history_tiers = std::max(tiers, 0);
+        d_tier_decimation = std::max(decimation, 1);
+        d_tier_reduce = mode;
+
+        for (int i = 0; i < d_nplots; i++)
+        {
+            d_data[i]->setHistoryTiers(d_history_tiers, d_tier_decimation, d_tier_reduce);
+            d_spectrogram[i]->invalidateImage();
+        }
+    }
+
+    // The time axis stretches by the decimation factor in every tier
+    QwtTimeScaleDraw *timeScale = (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
+    timeScale->setHistoryTiers(d_nrows, d_history_tiers, d_tier_decimation);
+    ((WaterfallZoomer *)d_zoomer)
+        ->setHistoryTiers(d_nrows, d_history_tiers, d_tier_decimation);
+
+    resetAxis();
+    replot();
+}
+
+int WaterfallVectorDisplayPlot::getHistoryTiers() const { return d_history_tiers; }
+
+void WaterfallVectorDisplayPlot::setCompositeMode(const int mode)
+{
+    QMutexLocker lock(&d_render_lock);
+    d_composite_mode = mode;
+    const bool composite = (d_composite_mode != gr::spectrogram::COMPOSITE_NONE);
+
+#if QWT_VERSION < 0x060000
+    std::vector<PlotWaterfall *> layers;
+#else
+    std::vector<WaterfallSpectrogram *> layers;
+#endif
+    for (int i = 1; i < d_nplots; i++)
+    {
+        if (composite)
+            layers.push_back(d_spectrogram[i]);
+        d_spectrogram[i]->setVisible(!composite);
+        d_spectrogram[i]->invalidateImage();
+    }
+    d_spectrogram[0]->setComposite(d_composite_mode, layers);
+    _updateTiles();
+    replot();
+}
+
+int WaterfallVectorDisplayPlot::getCompositeMode() const { return d_composite_mode; }
+
+void WaterfallVectorDisplayPlot::setTileLayout(const int layout)
+{
+    QMutexLocker lock(&d_render_lock);
+    d_tile_layout = layout;
+    _updateTiles();
+    replot();
+}
+
+int WaterfallVectorDisplayPlot::getTileLayout() const { return d_tile_layout; }
+
+void WaterfallVectorDisplayPlot::_updateTiles()
+{
+    // Only the inputs drawn get a band; composited ones are drawn by the
+    // first input, into its band
+    std::vector<int> shown;
+    for (int i = 0; i < d_nplots; i++)
+    {
+        if (d_spectrogram[i]->isVisible())
+            shown.push_back(i);
+    }
+
+    const bool stacked = (d_tile_layout == gr::spectrogram::TILE_STACKED);
+    d_tiles = stacked ? std::max((int)shown.size(), 1) : 1;
+    for (size_t i = 0; i < shown.size(); i++)
+    {
+        d_spectrogram[shown[i]]->setTile(d_tiles > 1 ? (int)i : 0, d_tiles);
+    }
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_spectrogram[i]->setAlpha(d_tiles > 1 ? 255 : d_alpha[i]);
+        d_spectrogram[i]->invalidateImage();
+    }
+
+    // Every band repeats the whole time range, which one axis cannot label
+    enableAxis(QwtPlot::yLeft, d_tiles == 1);
+    ((WaterfallZoomer *)d_zoomer)->setTiles(d_tiles);
+}
+
+void WaterfallVectorDisplayPlot::setMetrics(WaterfallMetrics::sptr metrics)
+{
+    QMutexLocker lock(&d_render_lock);
+    d_metrics = metrics;
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_spectrogram[i]->setMetrics(metrics);
+    }
+}
+
 void WaterfallVectorDisplayPlot::_updateIntensityRangeDisplay()
 {
     QwtScaleWidget *rightAxis = axisWidget(QwtPlot::yRight);
@@ -648,6 +959,27 @@ void WaterfallVectorDisplayPlot::enableLegend(bool en)
     enableAxis(QwtPlot::yRight, en);
 }
 
-void WaterfallVectorDisplayPlot::setNumRows(int nrows) { d_nrows = nrows; }
+void WaterfallVectorDisplayPlot::setNumRows(int nrows)
+{
+    QMutexLocker lock(&d_render_lock);
+    if ((nrows <= 0) || (nrows == d_nrows))
+        return;
+
+    // Unlike resetAxis() this keeps the newest rows of the history
+    d_nrows = nrows;
+    for (int i = 0; i < d_nplots; i++)
+    {
+        d_data[i]->setHistoryLength(d_nrows);
+        d_spectrogram[i]->invalidateImage();
+    }
+
+    QwtTimeScaleDraw *timeScale = (QwtTimeScaleDraw *)axisScaleDraw(QwtPlot::yLeft);
+    timeScale->setHistoryTiers(d_nrows, d_history_tiers, d_tier_decimation);
+    ((WaterfallZoomer *)d_zoomer)
+        ->setHistoryTiers(d_nrows, d_history_tiers, d_tier_decimation);
+
+    _resetZoom();
+    replot();
+}
 
 #endif /* WATERFALL_DISPLAY_PLOT_C */
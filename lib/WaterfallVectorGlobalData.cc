@@ -21,13 +21,20 @@
 #ifndef WATERFALL_GLOBAL_DATA_CPP
 #define WATERFALL_GLOBAL_DATA_CPP
 
+#include "storage_codec.h"
 #include <spectrogram/WaterfallVectorGlobalData.h>
 #include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 
 WaterfallVectorData::WaterfallVectorData(const double minimumFrequency,
                              const double maximumFrequency,
                              const uint64_t vecPoints,
-                             const unsigned int historyExtent)
+                             const unsigned int historyExtent,
+                             const int storageType,
+                             const double storageOffset,
+                             const double storageScale)
 #if QWT_VERSION < 0x060000
     : QwtRasterData(QwtDoubleRect(minimumFrequency /* X START */,
                                   0 /* Y START */,
@@ -42,7 +49,21 @@ WaterfallVectorData::WaterfallVectorData(const double minimumFrequency,
     _vecPoints = vecPoints;
     _historyLength = historyExtent;
 
-    _spectrumData = new double[_vecPoints * _historyLength];
+    _historyTiers = 0;
+    _tierDecimation = 1;
+    _tierReduce = gr::spectrogram::BIN_REDUCE_MAX;
+
+    _storageType = storageType;
+    _storageOffset = storageOffset;
+    _storageScale =
+        gr::spectrogram::storage_codec(storageType, storageOffset, storageScale).scale();
+
+    _aggregation = gr::spectrogram::BIN_REDUCE_NONE;
+    _pyramidLevels = 0;
+    _pyramidStride = 0;
+
+    _spectrumData = NULL;
+    _allocateData();
 
 #if QWT_VERSION >= 0x060000
     setInterval(Qt::XAxis, QwtInterval(minimumFrequency, maximumFrequency));
@@ -57,32 +78,61 @@ WaterfallVectorData::~WaterfallVectorData() { delete[] _spectrumData; }
 
 void WaterfallVectorData::reset()
 {
-    memset(_spectrumData, 0x0, _vecPoints * _historyLength * sizeof(double));
+    memset(_spectrumData, 0x0, _vecPoints * getNumRows() * _sampleSize());
+    std::fill(_rowValid.begin(), _rowValid.end(), 0);
+    std::fill(_tierHead.begin(), _tierHead.end(), 0);
+    std::fill(_tierCount.begin(), _tierCount.end(), 0);
+    std::fill(_tierValid.begin(), _tierValid.end(), 0);
 
-    _numLinesToUpdate = -1;
+    setNumLinesToUpdate(-1);
 }
 
 void WaterfallVectorData::copy(const WaterfallVectorData* rhs)
 {
 #if QWT_VERSION < 0x060000
     if ((_vecPoints != rhs->getNumVecPoints()) ||
+        (_storageType != rhs->getStorageType()) ||
+        (_historyTiers != rhs->getHistoryTiers()) ||
+        (_historyLength != rhs->getHistoryLength()) ||
         (boundingRect() != rhs->boundingRect())) {
         _vecPoints = rhs->getNumVecPoints();
+        _storageType = rhs->getStorageType();
+        _historyTiers = rhs->getHistoryTiers();
+        _historyLength = rhs->getHistoryLength();
         setBoundingRect(rhs->boundingRect());
-        delete[] _spectrumData;
-        _spectrumData = new double[_vecPoints * _historyLength];
+        _allocateData();
     }
 #else
-    if (_vecPoints != rhs->getNumVecPoints()) {
+    if ((_vecPoints != rhs->getNumVecPoints()) ||
+        (_storageType != rhs->getStorageType()) ||
+        (_historyTiers != rhs->getHistoryTiers()) ||
+        (_historyLength != rhs->getHistoryLength())) {
         _vecPoints = rhs->getNumVecPoints();
-        delete[] _spectrumData;
-        _spectrumData = new double[_vecPoints * _historyLength];
+        _storageType = rhs->getStorageType();
+        _historyTiers = rhs->getHistoryTiers();
+        _historyLength = rhs->getHistoryLength();
+        _allocateData();
     }
 #endif
+    _tierDecimation = rhs->getTierDecimation();
+    _tierReduce = rhs->_tierReduce;
+    _storageOffset = rhs->getStorageOffset();
+    _storageScale = rhs->getStorageScale();
 
     reset();
-    setSpectrumDataBuffer(rhs->getSpectrumDataBuffer());
-    setNumLinesToUpdate(rhs->getNumLinesToUpdate());
+    memcpy(_spectrumData,
+           rhs->getSpectrumDataBuffer(),
+           _vecPoints * getNumRows() * _sampleSize());
+    _rowValid = rhs->_rowValid;
+    _tierHead = rhs->_tierHead;
+    _tierAccum = rhs->_tierAccum;
+    _tierCount = rhs->_tierCount;
+    _tierValid = rhs->_tierValid;
+    _numLinesToUpdate = rhs->getNumLinesToUpdate();
+    _tierScrolled = rhs->_tierScrolled;
+
+    _aggregation = rhs->getAggregation();
+    _buildPyramid();
 
 #if QWT_VERSION < 0x060000
     setRange(rhs->range());
@@ -99,7 +149,7 @@ void WaterfallVectorData::resizeData(const double startFreq,
                                const int history)
 {
     if (history > 0) {
-        _historyLength = history;
+        setHistoryLength(history);
     }
 
 #if QWT_VERSION < 0x060000
@@ -108,10 +158,9 @@ void WaterfallVectorData::resizeData(const double startFreq,
         (boundingRect().left() != startFreq)) {
 
         setBoundingRect(QwtDoubleRect(
-            startFreq, 0, stopFreq - startFreq, static_cast<double>(_historyLength)));
+            startFreq, 0, stopFreq - startFreq, static_cast<double>(getNumRows())));
         _vecPoints = vecPoints;
-        delete[] _spectrumData;
-        _spectrumData = new double[_vecPoints * _historyLength];
+        _allocateData();
     }
 
 #else
@@ -120,27 +169,115 @@ void WaterfallVectorData::resizeData(const double startFreq,
         (interval(Qt::XAxis).minValue() != startFreq)) {
 
         setInterval(Qt::XAxis, QwtInterval(startFreq, stopFreq));
-        setInterval(Qt::YAxis, QwtInterval(0, _historyLength));
+        setInterval(Qt::YAxis, QwtInterval(0, getNumRows()));
 
         _vecPoints = vecPoints;
-        delete[] _spectrumData;
-        _spectrumData = new double[_vecPoints * _historyLength];
+        _allocateData();
     }
 #endif
 
     reset();
 }
 
+void WaterfallVectorData::remapData(const double startFreq,
+                                    const double stopFreq,
+                                    const uint64_t vecPoints)
+{
+#if QWT_VERSION < 0x060000
+    const double left = boundingRect().left();
+    const double right = boundingRect().right();
+    const float floor = static_cast<float>(_intensityRange.minValue());
+#else
+    const double left = interval(Qt::XAxis).minValue();
+    const double right = interval(Qt::XAxis).maxValue();
+    const float floor = static_cast<float>(interval(Qt::ZAxis).minValue());
+#endif
+    if ((vecPoints == _vecPoints) && (left == startFreq) && (right == stopFreq)) {
+        return;
+    }
+    if ((vecPoints == 0) || (_vecPoints == 0) || (right <= left)) {
+        resizeData(startFreq, stopFreq, vecPoints);
+        return;
+    }
+
+    // Old bin at the frequency of every new one, placed as value() does
+    std::vector<int64_t> bins(vecPoints);
+    const double newStep =
+        (vecPoints > 1) ? (stopFreq - startFreq) / static_cast<double>(vecPoints - 1) : 0.0;
+    const double binScale = static_cast<double>(_vecPoints - 1) / (right - left);
+    for (uint64_t bin = 0; bin < vecPoints; bin++) {
+        const double old = (startFreq + bin * newStep - left) * binScale + 0.5;
+        bins[bin] = ((old >= 0.0) && (old < static_cast<double>(_vecPoints)))
+                        ? static_cast<int64_t>(old)
+                        : -1;
+    }
+
+    const gr::spectrogram::storage_codec codec(_storageType, _storageOffset, _storageScale);
+    const uint64_t rows = getNumRows();
+    const size_t oldRowBytes = _vecPoints * codec.sample_size();
+    const size_t rowBytes = vecPoints * codec.sample_size();
+    uint8_t* spectrumData = new uint8_t[rowBytes * rows];
+    memset(spectrumData, 0x0, rowBytes * rows);
+
+    std::vector<float> oldLine(_vecPoints);
+    std::vector<float> line(vecPoints);
+    for (uint64_t row = 0; row < rows; row++) {
+        if (!_rowValid[row]) {
+            continue;
+        }
+        codec.decode(&oldLine[0], &_spectrumData[row * oldRowBytes], _vecPoints);
+        for (uint64_t bin = 0; bin < vecPoints; bin++) {
+            line[bin] = (bins[bin] >= 0) ? oldLine[bins[bin]] : floor;
+        }
+        codec.encode(&spectrumData[row * rowBytes], &line[0], vecPoints);
+    }
+
+    // Partially pooled lines of the coarser tiers follow the same map; a
+    // mean accumulator holds the sum of its valid lines
+    std::vector<float> tierAccum(_historyTiers * vecPoints);
+    for (unsigned int tier = 0; tier < _historyTiers; tier++) {
+        const float fill = (_tierReduce == gr::spectrogram::BIN_REDUCE_MEAN)
+                               ? floor * std::max(_tierValid[tier + 1], 1u)
+                               : floor;
+        for (uint64_t bin = 0; bin < vecPoints; bin++) {
+            tierAccum[tier * vecPoints + bin] =
+                (bins[bin] >= 0) ? _tierAccum[tier * _vecPoints + bins[bin]] : fill;
+        }
+    }
+
+    delete[] _spectrumData;
+    _spectrumData = spectrumData;
+    _tierAccum.swap(tierAccum);
+    _vecPoints = vecPoints;
+    _buildPyramid();
+
+#if QWT_VERSION < 0x060000
+    setBoundingRect(QwtDoubleRect(
+        startFreq, 0, stopFreq - startFreq, static_cast<double>(getNumRows())));
+#else
+    setInterval(Qt::XAxis, QwtInterval(startFreq, stopFreq));
+#endif
+    setNumLinesToUpdate(-1);
+}
+
 QwtRasterData* WaterfallVectorData::copy() const
 {
 #if QWT_VERSION < 0x060000
-    WaterfallVectorData* returnData = new WaterfallVectorData(
-        boundingRect().left(), boundingRect().right(), _vecPoints, _historyLength);
+    WaterfallVectorData* returnData = new WaterfallVectorData(boundingRect().left(),
+                                                              boundingRect().right(),
+                                                              _vecPoints,
+                                                              _historyLength,
+                                                              _storageType,
+                                                              _storageOffset,
+                                                              _storageScale);
 #else
     WaterfallVectorData* returnData = new WaterfallVectorData(interval(Qt::XAxis).minValue(),
                                                   interval(Qt::XAxis).maxValue(),
                                                   _vecPoints,
-                                                  _historyLength);
+                                                  _historyLength,
+                                                  _storageType,
+                                                  _storageOffset,
+                                                  _storageScale);
 #endif
 
     returnData->copy(this);
@@ -164,81 +301,595 @@ double WaterfallVectorData::value(double x, double y) const
     double returnValue = 0.0;
 
 #if QWT_VERSION < 0x060000
-    const unsigned int intY = static_cast<unsigned int>(
-        (1.0 - (y / boundingRect().height())) * static_cast<double>(_historyLength - 1));
     const unsigned int intX = static_cast<unsigned int>(
         (((x - boundingRect().left()) / boundingRect().width()) *
          static_cast<double>(_vecPoints - 1)) +
         0.5);
 #else
-    double height = interval(Qt::YAxis).maxValue();
     double left = interval(Qt::XAxis).minValue();
     double right = interval(Qt::XAxis).maxValue();
-    double ylen = static_cast<double>(_historyLength - 1);
     double xlen = static_cast<double>(_vecPoints - 1);
-    const unsigned int intY = static_cast<unsigned int>((1.0 - y / height) * ylen);
     const unsigned int intX =
         static_cast<unsigned int>((((x - left) / (right - left)) * xlen) + 0.5);
 #endif
+    const int64_t intY = rowIndex(y);
 
-    const int location = (intY * _vecPoints) + intX;
-    if ((location > -1) &&
-        (location < static_cast<int64_t>(_vecPoints * _historyLength))) {
-        returnValue = _spectrumData[location];
+    if ((intY >= 0) && (intX < _vecPoints)) {
+        const uint64_t row = _physicalRow(intY);
+        if (_rowValid[row]) {
+            returnValue = _sample(row, intX);
+        }
     }
 
     return returnValue;
 }
 
+int64_t WaterfallVectorData::rowIndex(double y) const
+{
+#if QWT_VERSION < 0x060000
+    const double height = boundingRect().height();
+#else
+    const double height = interval(Qt::YAxis).maxValue();
+#endif
+    const double rows = static_cast<double>(getNumRows());
+    const double row = (1.0 - y / height) * (rows - 1.0);
+
+    // Truncated towards zero, as value() always did
+    if (!(row > -1.0) || (row >= rows)) {
+        return -1;
+    }
+    return static_cast<int64_t>(row);
+}
+
+#if QWT_VERSION < 0x060000
+void WaterfallVectorData::initRaster(const QwtDoubleRect& area, const QSize& raster)
+{
+    const double left = boundingRect().left();
+    const double right = boundingRect().right();
+#else
+void WaterfallVectorData::initRaster(const QRectF& area, const QSize& raster)
+{
+    const double left = interval(Qt::XAxis).minValue();
+    const double right = interval(Qt::XAxis).maxValue();
+#endif
+    const int width = std::max(raster.width(), 0);
+    const int height = std::max(raster.height(), 0);
+
+    // Sampled where the renderers' image maps put each pixel, so a line
+    // built from the tables matches value() along the same line
+    _rasterBins.resize(width);
+    const double xStep = (width > 0) ? area.width() / width : 0.0;
+    const double binScale = static_cast<double>(_vecPoints - 1) / (right - left);
+    for (int col = 0; col < width; col++) {
+        const double bin = (area.left() + col * xStep - left) * binScale + 0.5;
+        _rasterBins[col] = ((bin >= 0.0) && (bin < static_cast<double>(_vecPoints)))
+                               ? static_cast<int64_t>(bin)
+                               : -1;
+    }
+
+    // Aggregating columns span the bins up to the next column's, tiled
+    // by the largest aligned pyramid cells that fit
+    _rasterCellStart.clear();
+    _rasterCells.clear();
+    _rasterCellWeights.clear();
+    if (_aggregation != gr::spectrogram::BIN_REDUCE_NONE) {
+        _rasterCellStart.resize(width + 1, 0);
+        const int64_t points = static_cast<int64_t>(_vecPoints);
+        double edge = (area.left() - left) * binScale + 0.5;
+        for (int col = 0; col < width; col++) {
+            const double next = (area.left() + (col + 1) * xStep - left) * binScale + 0.5;
+            int64_t first = static_cast<int64_t>(std::max(edge, 0.0));
+            int64_t last = std::min(static_cast<int64_t>(std::max(next, 0.0)), points);
+            edge = next;
+
+            _rasterCellStart[col] = _rasterCells.size();
+            if ((next <= 0.0) || (first >= points)) {
+                _rasterBins[col] = -1;
+                continue;
+            }
+            _rasterBins[col] = first;
+            last = std::max(last, first + 1);
+
+            while (first < last) {
+                unsigned int level = 0;
+                while ((level < _pyramidLevels) && !(first & ((int64_t(2) << level) - 1)) &&
+                       (first + (int64_t(2) << level) <= last)) {
+                    level++;
+                }
+                _rasterCells.push_back(level ? static_cast<int64_t>(_levelOffset[level]) +
+                                                   (first >> level)
+                                             : -(first + 1));
+                _rasterCellWeights.push_back(static_cast<float>(int64_t(1) << level));
+                first += int64_t(1) << level;
+            }
+        }
+        _rasterCellStart[width] = _rasterCells.size();
+    }
+
+    _rasterRows.resize(height);
+    const double yStep = (height > 0) ? area.height() / height : 0.0;
+    for (int line = 0; line < height; line++) {
+        _rasterRows[line] = rowIndex(area.bottom() - line * yStep);
+    }
+}
+
+void WaterfallVectorData::discardRaster()
+{
+    std::vector<int64_t>().swap(_rasterBins);
+    std::vector<size_t>().swap(_rasterCellStart);
+    std::vector<int64_t>().swap(_rasterCells);
+    std::vector<float>().swap(_rasterCellWeights);
+    std::vector<int64_t>().swap(_rasterRows);
+}
+
+const std::vector<int64_t>& WaterfallVectorData::getRasterRows() const
+{
+    return _rasterRows;
+}
+
+void WaterfallVectorData::getRasterLine(const int64_t row,
+                                        float* lineData,
+                                        const int64_t rows) const
+{
+    if (!_rasterCellStart.empty()) {
+        _getAggregatedLine(row, lineData, rows);
+        return;
+    }
+
+    const size_t width = _rasterBins.size();
+    if ((row < 0) || !isRowValid(row)) {
+        std::fill(lineData, lineData + width, 0.0f);
+        return;
+    }
+
+    const uint64_t index = _physicalRow(row) * _vecPoints;
+    const int64_t* bins = width ? &_rasterBins[0] : NULL;
+    const float offset = static_cast<float>(_storageOffset);
+    const float scale = static_cast<float>(_storageScale);
+
+    // One loop per storage type so the column loop is a plain gather
+    switch (_storageType) {
+    case gr::spectrogram::STORAGE_UINT16: {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(_spectrumData) + index;
+        for (size_t col = 0; col < width; col++) {
+            lineData[col] = (bins[col] >= 0) ? offset + src[bins[col]] * scale : 0.0f;
+        }
+        break;
+    }
+    case gr::spectrogram::STORAGE_UINT8: {
+        const uint8_t* src = _spectrumData + index;
+        for (size_t col = 0; col < width; col++) {
+            lineData[col] = (bins[col] >= 0) ? offset + src[bins[col]] * scale : 0.0f;
+        }
+        break;
+    }
+    default: {
+        const float* src = reinterpret_cast<const float*>(_spectrumData) + index;
+        for (size_t col = 0; col < width; col++) {
+            lineData[col] = (bins[col] >= 0) ? src[bins[col]] : 0.0f;
+        }
+        break;
+    }
+    }
+}
+
+void WaterfallVectorData::_getAggregatedLine(const int64_t row,
+                                             float* lineData,
+                                             const int64_t rows) const
+{
+    const size_t width = _rasterBins.size();
+    const bool mean = (_aggregation == gr::spectrogram::BIN_REDUCE_MEAN);
+    const gr::spectrogram::storage_codec codec(_storageType, _storageOffset, _storageScale);
+    const size_t levelBytes = _pyramidStride * codec.sample_size();
+    int validRows = 0;
+
+    for (int64_t r = std::max<int64_t>(row - std::max<int64_t>(rows, 1) + 1, 0); r <= row;
+         r++) {
+        if (!isRowValid(r)) {
+            continue;
+        }
+
+        const uint64_t physical = _physicalRow(r);
+        const uint8_t* levels = _pyramidStride ? &_pyramid[physical * levelBytes] : NULL;
+
+        for (size_t col = 0; col < width; col++) {
+            if (_rasterBins[col] < 0) {
+                continue;
+            }
+
+            float v = mean ? 0.0f : -std::numeric_limits<float>::max();
+            float weight = 0.0f;
+            for (size_t i = _rasterCellStart[col]; i < _rasterCellStart[col + 1]; i++) {
+                const int64_t cell = _rasterCells[i];
+                const float c = static_cast<float>(
+                    (cell >= 0) ? codec.sample(levels, cell) : _sample(physical, -cell - 1));
+                if (mean) {
+                    v += c * _rasterCellWeights[i];
+                    weight += _rasterCellWeights[i];
+                } else {
+                    v = std::max(v, c);
+                }
+            }
+            if (mean) {
+                v /= weight;
+                lineData[col] = validRows ? lineData[col] + v : v;
+            } else {
+                lineData[col] = validRows ? std::max(lineData[col], v) : v;
+            }
+        }
+        validRows++;
+    }
+
+    for (size_t col = 0; col < width; col++) {
+        if (!validRows || (_rasterBins[col] < 0)) {
+            lineData[col] = 0.0f;
+        } else if (mean) {
+            lineData[col] /= static_cast<float>(validRows);
+        }
+    }
+}
+
+int WaterfallVectorData::getAggregation() const { return _aggregation; }
+
+void WaterfallVectorData::setAggregation(const int mode)
+{
+    if (mode != _aggregation) {
+        _aggregation = mode;
+        _buildPyramid();
+    }
+}
+
 uint64_t WaterfallVectorData::getNumVecPoints() const { return _vecPoints; }
 
-void WaterfallVectorData::addVecData(const double* vecData,
+uint64_t WaterfallVectorData::getHistoryLength() const { return _historyLength; }
+
+uint64_t WaterfallVectorData::getNumRows() const
+{
+    return _historyLength * (_historyTiers + 1);
+}
+
+void WaterfallVectorData::setHistoryLength(const uint64_t history)
+{
+    if ((history == 0) || (history == _historyLength)) {
+        return;
+    }
+
+    // Move the newest lines of every tier to the end of its new ring,
+    // behind any emptied rows, so that each head starts over at row 0
+    const uint64_t keep = std::min(history, _historyLength);
+    const size_t rowBytes = _vecPoints * _sampleSize();
+    const uint64_t rows = history * (_historyTiers + 1);
+    uint8_t* spectrumData = new uint8_t[rowBytes * rows];
+    memset(spectrumData, 0x0, rowBytes * rows);
+    std::vector<uint8_t> rowValid(rows, 0);
+
+    for (unsigned int tier = 0; tier <= _historyTiers; tier++) {
+        for (uint64_t i = 0; i < keep; i++) {
+            const uint64_t src =
+                tier * _historyLength +
+                (_tierHead[tier] + _historyLength - keep + i) % _historyLength;
+            const uint64_t dst = tier * history + history - keep + i;
+            memcpy(&spectrumData[dst * rowBytes], &_spectrumData[src * rowBytes], rowBytes);
+            rowValid[dst] = _rowValid[src];
+        }
+        _tierHead[tier] = 0;
+    }
+
+    delete[] _spectrumData;
+    _spectrumData = spectrumData;
+    _rowValid.swap(rowValid);
+    _historyLength = history;
+    _buildPyramid();
+
+#if QWT_VERSION < 0x060000
+    QwtDoubleRect rect = boundingRect();
+    rect.setHeight(static_cast<double>(getNumRows()));
+    setBoundingRect(rect);
+#else
+    setInterval(Qt::YAxis, QwtInterval(0, getNumRows()));
+#endif
+    setNumLinesToUpdate(-1);
+}
+
+uint64_t WaterfallVectorData::getMemoryUsage() const
+{
+    return _vecPoints * getNumRows() * _sampleSize() + _rowValid.size() + _pyramid.size() +
+           (_pyramidScratch.size() + _tierAccum.size()) * sizeof(float);
+}
+
+void WaterfallVectorData::setHistoryTiers(const unsigned int tiers,
+                                          const unsigned int decimation,
+                                          const int mode)
+{
+    _historyTiers = tiers;
+    _tierDecimation = std::max(decimation, 1u);
+    _tierReduce = (mode == gr::spectrogram::BIN_REDUCE_MEAN)
+                      ? gr::spectrogram::BIN_REDUCE_MEAN
+                      : gr::spectrogram::BIN_REDUCE_MAX;
+
+    _allocateData();
+#if QWT_VERSION < 0x060000
+    QwtDoubleRect rect = boundingRect();
+    rect.setHeight(static_cast<double>(getNumRows()));
+    setBoundingRect(rect);
+#else
+    setInterval(Qt::YAxis, QwtInterval(0, getNumRows()));
+#endif
+    reset();
+}
+
+unsigned int WaterfallVectorData::getHistoryTiers() const { return _historyTiers; }
+
+unsigned int WaterfallVectorData::getTierDecimation() const { return _tierDecimation; }
+
+void WaterfallVectorData::addVecData(const float* vecData,
                                const uint64_t vecDataSize,
                                const int droppedFrames)
 {
     if (vecDataSize == _vecPoints) {
-        int64_t heightOffset = _historyLength - 1 - droppedFrames;
-        uint64_t drawingDroppedFrames = droppedFrames;
+        // The history is a ring of rows; rolling it by one line (plus one per
+        // dropped frame) is just a head advance. Rows skipped for dropped
+        // frames are flagged invalid so they read back as zeros.
+        uint64_t advance = (droppedFrames > 0) ? droppedFrames + 1 : 1;
+        if (advance > _historyLength) {
+            advance = _historyLength;
+        }
 
-        // Any valid data rolled off the display so just fill in zeros and write new data
-        if (heightOffset < 0) {
-            heightOffset = 0;
-            drawingDroppedFrames = static_cast<uint64_t>(_historyLength - 1);
+        for (uint64_t row = 1; row < advance; row++) {
+            _pushRow(0, NULL);
         }
+        _pushRow(0, vecData);
 
-        // Copy the old data over if any available
-        if (heightOffset > 0) {
-            memmove(_spectrumData,
-                    &_spectrumData[(drawingDroppedFrames + 1) * _vecPoints],
-                    heightOffset * _vecPoints * sizeof(double));
+        // Lines a renderer can scroll in; -1 means it has to redraw
+        if (_numLinesToUpdate >= 0) {
+            _numLinesToUpdate += static_cast<int>(advance);
         }
+    }
+}
+
+void WaterfallVectorData::_pushRow(const unsigned int tier, const float* rowData)
+{
+    // The oldest line of the tier is overwritten; the next tier pools it
+    const uint64_t row = tier * _historyLength + _tierHead[tier];
+    if (tier < _historyTiers) {
+        _feedTier(tier + 1, row);
+    }
+
+    _tierHead[tier] = (_tierHead[tier] + 1 == _historyLength) ? 0 : _tierHead[tier] + 1;
+    _tierScrolled[tier]++;
 
-        if (drawingDroppedFrames > 0) {
-            // Fill in zeros data for dropped data
-            memset(&_spectrumData[heightOffset * _vecPoints],
-                   0x00,
-                   static_cast<int64_t>(drawingDroppedFrames) * _vecPoints *
-                       sizeof(double));
+    if (rowData) {
+        _storeRow(row, rowData);
+        _rowValid[row] = 1;
+        if (_aggregation != gr::spectrogram::BIN_REDUCE_NONE) {
+            _updatePyramid(row);
         }
+    } else {
+        _rowValid[row] = 0;
+    }
+}
 
-        // add the new buffer
-        memcpy(&_spectrumData[(_historyLength - 1) * _vecPoints],
-               vecData,
-               _vecPoints * sizeof(double));
+void WaterfallVectorData::_feedTier(const unsigned int tier, const uint64_t row)
+{
+    float* accum = &_tierAccum[(tier - 1) * _vecPoints];
+
+    if (_rowValid[row]) {
+        float* line = &_pyramidScratch[0];
+        _decodeRow(row, line);
+        if (!_tierValid[tier]) {
+            memcpy(accum, line, _vecPoints * sizeof(float));
+        } else if (_tierReduce == gr::spectrogram::BIN_REDUCE_MEAN) {
+            for (uint64_t bin = 0; bin < _vecPoints; bin++) {
+                accum[bin] += line[bin];
+            }
+        } else {
+            for (uint64_t bin = 0; bin < _vecPoints; bin++) {
+                accum[bin] = std::max(accum[bin], line[bin]);
+            }
+        }
+        _tierValid[tier]++;
+    }
+
+    if (++_tierCount[tier] < _tierDecimation) {
+        return;
+    }
+
+    // A pooled line with no valid input stays invalid, like a dropped row
+    if (_tierValid[tier] && (_tierReduce == gr::spectrogram::BIN_REDUCE_MEAN)) {
+        const float scale = 1.0f / _tierValid[tier];
+        for (uint64_t bin = 0; bin < _vecPoints; bin++) {
+            accum[bin] *= scale;
+        }
+    }
+    const bool valid = (_tierValid[tier] > 0);
+    _tierCount[tier] = 0;
+    _tierValid[tier] = 0;
+    _pushRow(tier, valid ? accum : NULL);
+}
+
+int WaterfallVectorData::getStorageType() const { return _storageType; }
+
+double WaterfallVectorData::getStorageOffset() const { return _storageOffset; }
+
+double WaterfallVectorData::getStorageScale() const { return _storageScale; }
+
+void WaterfallVectorData::setStorageType(const int type,
+                                         const double offset,
+                                         const double scale)
+{
+    _storageOffset = offset;
+    _storageScale = gr::spectrogram::storage_codec(type, offset, scale).scale();
+
+    if (type != _storageType) {
+        _storageType = type;
+        _allocateData();
+    }
+
+    reset();
+}
+
+void* WaterfallVectorData::getSpectrumDataBuffer() const { return _spectrumData; }
+
+void WaterfallVectorData::setSpectrumDataBuffer(const float* newData)
+{
+    // Fills the full-resolution tier; coarser tiers start out empty
+    reset();
+    for (uint64_t row = 0; row < _historyLength; row++) {
+        _storeRow(row, &newData[row * _vecPoints]);
+        _rowValid[row] = 1;
     }
+    _buildPyramid();
 }
 
-double* WaterfallVectorData::getSpectrumDataBuffer() const { return _spectrumData; }
+uint64_t WaterfallVectorData::getHistoryHead() const { return _tierHead[0]; }
 
-void WaterfallVectorData::setSpectrumDataBuffer(const double* newData)
+int64_t WaterfallVectorData::getPreviousRow(const int64_t row) const
 {
-    memcpy(_spectrumData, newData, _vecPoints * _historyLength * sizeof(double));
+    if ((_numLinesToUpdate < 0) || (row < 0) || (row >= static_cast<int64_t>(getNumRows()))) {
+        return -1;
+    }
+
+    // Every tier scrolls on its own; a row that was not on screen in its
+    // tier before has no previous line
+    const uint64_t block = row / _historyLength;
+    const uint64_t scrolled = _tierScrolled[_historyTiers - block];
+    const uint64_t inTier = row - block * _historyLength + scrolled;
+    return (inTier < _historyLength) ? static_cast<int64_t>(block * _historyLength + inTier)
+                                     : -1;
+}
+
+bool WaterfallVectorData::isRowValid(const uint64_t row) const
+{
+    return (row < getNumRows()) && _rowValid[_physicalRow(row)];
+}
+
+bool WaterfallVectorData::getRow(const uint64_t row, float* rowData) const
+{
+    if (!isRowValid(row)) {
+        memset(rowData, 0x0, _vecPoints * sizeof(float));
+        return false;
+    }
+
+    _decodeRow(_physicalRow(row), rowData);
+    return true;
+}
+
+void WaterfallVectorData::_allocateData()
+{
+    delete[] _spectrumData;
+    _spectrumData = new uint8_t[_vecPoints * getNumRows() * _sampleSize()];
+    _rowValid.assign(getNumRows(), 0);
+
+    _tierHead.assign(_historyTiers + 1, 0);
+    _tierScrolled.assign(_historyTiers + 1, 0);
+    _tierAccum.assign(_historyTiers * _vecPoints, 0.0f);
+    _tierCount.assign(_historyTiers + 1, 0);
+    _tierValid.assign(_historyTiers + 1, 0);
+    _allocatePyramid();
+}
+
+void WaterfallVectorData::_allocatePyramid()
+{
+    _pyramidLevels = 0;
+    _pyramidStride = 0;
+    _levelOffset.assign(1, 0);
+    _levelSize.assign(1, _vecPoints);
+
+    if (_aggregation != gr::spectrogram::BIN_REDUCE_NONE) {
+        while (_levelSize.back() > 1) {
+            _levelOffset.push_back(_pyramidStride);
+            _levelSize.push_back((_levelSize.back() + 1) / 2);
+            _pyramidStride += _levelSize.back();
+            _pyramidLevels++;
+        }
+    }
+
+    std::vector<uint8_t>(_pyramidStride * getNumRows() * _sampleSize()).swap(_pyramid);
+    std::vector<float>((_pyramidLevels || _historyTiers) ? _vecPoints + _pyramidStride : 0)
+        .swap(_pyramidScratch);
+}
+
+void WaterfallVectorData::_updatePyramid(const uint64_t row)
+{
+    if (!_pyramidLevels) {
+        return;
+    }
+
+    // Built from the stored samples, so every level agrees with what
+    // value() reads back in the quantized formats, and then quantized
+    // the same way so the pyramid keeps their memory savings
+    _decodeRow(row, &_pyramidScratch[0]);
+    const bool mean = (_aggregation == gr::spectrogram::BIN_REDUCE_MEAN);
+    float* base = &_pyramidScratch[_vecPoints];
+
+    const float* src = &_pyramidScratch[0];
+    for (unsigned int level = 1; level <= _pyramidLevels; level++) {
+        float* dst = base + _levelOffset[level];
+        const uint64_t srcSize = _levelSize[level - 1];
+        const uint64_t pairs = srcSize / 2;
+
+        for (uint64_t i = 0; i < pairs; i++) {
+            dst[i] = mean ? 0.5f * (src[2 * i] + src[2 * i + 1])
+                          : std::max(src[2 * i], src[2 * i + 1]);
+        }
+        if (srcSize & 1) {
+            dst[pairs] = src[srcSize - 1];
+        }
+        src = dst;
+    }
+
+    const gr::spectrogram::storage_codec codec(_storageType, _storageOffset, _storageScale);
+    codec.encode(&_pyramid[row * _pyramidStride * codec.sample_size()], base, _pyramidStride);
+}
+
+void WaterfallVectorData::_buildPyramid()
+{
+    _allocatePyramid();
+    for (uint64_t row = 0; row < getNumRows(); row++) {
+        if (_rowValid[row]) {
+            _updatePyramid(row);
+        }
+    }
+}
+
+size_t WaterfallVectorData::_sampleSize() const
+{
+    return gr::spectrogram::storage_codec(_storageType).sample_size();
+}
+
+void WaterfallVectorData::_storeRow(const uint64_t row, const float* rowData)
+{
+    const gr::spectrogram::storage_codec codec(_storageType, _storageOffset, _storageScale);
+    codec.encode(&_spectrumData[row * _vecPoints * codec.sample_size()], rowData, _vecPoints);
+}
+
+void WaterfallVectorData::_decodeRow(const uint64_t row, float* rowData) const
+{
+    const gr::spectrogram::storage_codec codec(_storageType, _storageOffset, _storageScale);
+    codec.decode(rowData, &_spectrumData[row * _vecPoints * codec.sample_size()], _vecPoints);
+}
+
+double WaterfallVectorData::_sample(const uint64_t row, const uint64_t bin) const
+{
+    return gr::spectrogram::storage_codec(_storageType, _storageOffset, _storageScale)
+        .sample(_spectrumData, (row * _vecPoints) + bin);
 }
 
 int WaterfallVectorData::getNumLinesToUpdate() const { return _numLinesToUpdate; }
 
-void WaterfallVectorData::setNumLinesToUpdate(const int newNum) { _numLinesToUpdate = newNum; }
+void WaterfallVectorData::setNumLinesToUpdate(const int newNum)
+{
+    _numLinesToUpdate = newNum;
+    std::fill(_tierScrolled.begin(), _tierScrolled.end(), 0);
+    if (!_tierScrolled.empty()) {
+        _tierScrolled[0] = std::max(newNum, 0);
+    }
+}
 
-void WaterfallVectorData::incrementNumLinesToUpdate() { _numLinesToUpdate++; }
+void WaterfallVectorData::incrementNumLinesToUpdate()
+{
+    _numLinesToUpdate++;
+    _tierScrolled[0]++;
+}
 
 #endif /* WATERFALL_GLOBAL_DATA_CPP */
@@ -23,50 +23,21 @@
 
 #include <spectrogram/WaterfallVectorUpdateEvents.h>
 
-WaterfallUpdateEvent::WaterfallUpdateEvent(const std::vector<double *> dataPoints,
-                                           const uint64_t numDataPoints,
-                                           const gr::high_res_timer_type dataTimestamp)
-    : QEvent(QEvent::Type(SpectrumUpdateEventType))
+WaterfallUpdateEvent::WaterfallUpdateEvent(WaterfallRowPool::sptr pool)
+    : QEvent(QEvent::Type(SpectrumUpdateEventType)), _pool(pool)
 {
-    if (numDataPoints < 1)
-    {
-        _numDataPoints = 1;
-    }
-    else
-    {
-        _numDataPoints = numDataPoints;
-    }
-
-    _nplots = dataPoints.size();
-    for (size_t i = 0; i < _nplots; i++)
-    {
-        _dataPoints.push_back(new double[_numDataPoints]);
-        if (numDataPoints > 0)
-        {
-            memcpy(_dataPoints[i], dataPoints[i], _numDataPoints * sizeof(double));
-        }
-    }
-
-    _dataTimestamp = dataTimestamp;
 }
 
-WaterfallUpdateEvent::~WaterfallUpdateEvent()
-{
-    for (size_t i = 0; i < _nplots; i++)
-    {
-        delete[] _dataPoints[i];
-    }
-}
+WaterfallUpdateEvent::~WaterfallUpdateEvent() {}
 
-const std::vector<double *> WaterfallUpdateEvent::getPoints() const { return _dataPoints; }
+WaterfallRowPool::sptr WaterfallUpdateEvent::getRowPool() const { return _pool; }
 
-uint64_t WaterfallUpdateEvent::getNumDataPoints() const { return _numDataPoints; }
-
-gr::high_res_timer_type WaterfallUpdateEvent::getDataTimestamp() const
+WaterfallFrameEvent::WaterfallFrameEvent() : QEvent(QEvent::Type(SpectrumFrameEventType))
 {
-    return _dataTimestamp;
 }
 
+WaterfallFrameEvent::~WaterfallFrameEvent() {}
+
 /***************************************************************************/
 
 SetFreqEvent::SetFreqEvent(const double centerFreq, const double bandwidth)
@@ -0,0 +1,123 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "bin_reducer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+bin_reducer::bin_reducer(unsigned int vlen)
+    : d_vlen(vlen), d_mode(BIN_REDUCE_NONE), d_width(0),
+      d_span_lo(0), d_span_hi(1), d_start(0), d_count(vlen)
+{
+  update_edges();
+}
+
+void bin_reducer::set_mode(bin_reduce_t mode)
+{
+  d_mode = mode;
+  update_edges();
+}
+
+void bin_reducer::configure(unsigned int width, double span_lo, double span_hi)
+{
+  span_lo = std::max(0.0, std::min(span_lo, 1.0));
+  span_hi = std::max(0.0, std::min(span_hi, 1.0));
+  if (span_hi <= span_lo)
+  {
+    span_lo = 0;
+    span_hi = 1;
+  }
+
+  if ((width == d_width) && (span_lo == d_span_lo) && (span_hi == d_span_hi))
+    return;
+
+  d_width = width;
+  d_span_lo = span_lo;
+  d_span_hi = span_hi;
+  update_edges();
+}
+
+unsigned int bin_reducer::out_len() const { return d_edges.size() - 1; }
+
+void bin_reducer::update_edges()
+{
+  if ((d_mode == BIN_REDUCE_NONE) || (d_width == 0))
+  {
+    // Pass the whole band through untouched
+    d_start = 0;
+    d_count = d_vlen;
+  }
+  else
+  {
+    d_start = (unsigned int)floor(d_span_lo * d_vlen);
+    unsigned int stop = (unsigned int)ceil(d_span_hi * d_vlen);
+    stop = std::min(std::max(stop, d_start + 1), d_vlen);
+    d_count = stop - d_start;
+  }
+
+  const unsigned int nout =
+      (d_mode == BIN_REDUCE_NONE || d_width == 0) ? d_count : std::min(d_width, d_count);
+
+  d_edges.assign(1, d_start);
+  d_edges.resize(nout + 1);
+  for (unsigned int k = 1; k <= nout; k++)
+    d_edges[k] = d_start + (unsigned int)((uint64_t)k * d_count / nout);
+}
+
+void bin_reducer::reduce(float *out, const float *in) const
+{
+  const unsigned int nout = out_len();
+
+  if (nout == d_count)
+  {
+    memcpy(out, in + d_start, d_count * sizeof(float));
+    return;
+  }
+
+  if (d_mode == BIN_REDUCE_MEAN)
+  {
+    for (unsigned int k = 0; k < nout; k++)
+    {
+      float sum = 0;
+      for (unsigned int b = d_edges[k]; b < d_edges[k + 1]; b++)
+        sum += in[b];
+      out[k] = sum / (d_edges[k + 1] - d_edges[k]);
+    }
+  }
+  else
+  {
+    for (unsigned int k = 0; k < nout; k++)
+      out[k] = *std::max_element(in + d_edges[k], in + d_edges[k + 1]);
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,76 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_BIN_REDUCER_H
+#define INCLUDED_SPECTROGRAM_BIN_REDUCER_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/bin_reduce.h>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Pools a span of a vector down to a fixed number of output bins.
+ *
+ * \details
+ * The span [start, start + count) of a \p vlen vector is split into
+ * out_len() groups of adjacent bins, each reduced to one value by its
+ * max or mean. When the span is no wider than the requested width the
+ * bins are passed through at full resolution. The group edges are only
+ * recomputed when the span or width changes.
+ */
+class SPECTROGRAM_API bin_reducer
+{
+public:
+  bin_reducer(unsigned int vlen);
+
+  void set_mode(bin_reduce_t mode);
+  bin_reduce_t mode() const { return d_mode; }
+
+  //! Sets the display width and the visible span as fractions of the band
+  void configure(unsigned int width, double span_lo, double span_hi);
+
+  unsigned int out_len() const;
+  double span_lo() const { return d_span_lo; }
+  double span_hi() const { return d_span_hi; }
+
+  void reduce(float *out, const float *in) const;
+
+private:
+  unsigned int d_vlen;
+  bin_reduce_t d_mode;
+  unsigned int d_width;
+  double d_span_lo;
+  double d_span_hi;
+  unsigned int d_start;
+  unsigned int d_count;
+  std::vector<unsigned int> d_edges;
+
+  void update_edges();
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_BIN_REDUCER_H */
@@ -0,0 +1,117 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "color_lut.h"
+#include <qwt_color_map.h>
+#include <algorithm>
+
+#if QWT_VERSION < 0x060000
+#include <qwt_double_interval.h>
+#else
+#include <qwt_interval.h>
+#endif
+
+namespace gr
+{
+namespace spectrogram
+{
+
+color_lut::color_lut() : d_valid(false), d_min(0), d_max(0), d_scale(0), d_table(SIZE) {}
+
+void color_lut::update(const QwtColorMap &map, double min, double max)
+{
+  if (d_valid && (min == d_min) && (max == d_max))
+    return;
+
+#if QWT_VERSION < 0x060000
+  const QwtDoubleInterval range(min, max);
+#else
+  const QwtInterval range(min, max);
+#endif
+
+  const double step = (max - min) / (SIZE - 1);
+  for (unsigned int k = 0; k < SIZE; k++)
+    d_table[k] = map.rgb(range, min + k * step);
+
+  d_min = min;
+  d_max = max;
+  d_scale = (max > min) ? (float)((SIZE - 1) / (max - min)) : 0.0f;
+  d_valid = true;
+}
+
+void color_lut::quantize(uint16_t *index, const float *in, unsigned int n) const
+{
+  const float offset = (float)d_min;
+  const float top = (float)(SIZE - 1);
+
+  // Written branch-free so the compiler can vectorize it; NaN maps to 0
+  for (unsigned int i = 0; i < n; i++)
+  {
+    float t = (in[i] - offset) * d_scale + 0.5f;
+    t = (t >= 0.0f) ? t : 0.0f;
+    t = (t <= top) ? t : top;
+    index[i] = (uint16_t)t;
+  }
+}
+
+void color_lut::map(QRgb *out, const float *in, unsigned int n) const
+{
+  static const unsigned int CHUNK = 256;
+  uint16_t index[CHUNK];
+  const QRgb *table = &d_table[0];
+
+  for (unsigned int offset = 0; offset < n; offset += CHUNK)
+  {
+    const unsigned int count = std::min(CHUNK, n - offset);
+    quantize(index, in + offset, count);
+    for (unsigned int i = 0; i < count; i++)
+      out[offset + i] = table[index[i]];
+  }
+}
+
+void color_lut::blend(QRgb *out, const float *in, unsigned int n, int alpha) const
+{
+  static const unsigned int CHUNK = 256;
+  uint16_t index[CHUNK];
+  const QRgb *table = &d_table[0];
+  const int a = std::max(0, std::min(alpha, 255));
+
+  for (unsigned int offset = 0; offset < n; offset += CHUNK)
+  {
+    const unsigned int count = std::min(CHUNK, n - offset);
+    quantize(index, in + offset, count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const QRgb src = table[index[i]];
+      const QRgb dst = out[offset + i];
+      out[offset + i] = qRgb(qRed(dst) + ((qRed(src) - qRed(dst)) * a) / 255,
+                             qGreen(dst) + ((qGreen(src) - qGreen(dst)) * a) / 255,
+                             qBlue(dst) + ((qBlue(src) - qBlue(dst)) * a) / 255);
+    }
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
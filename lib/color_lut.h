@@ -0,0 +1,77 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_COLOR_LUT_H
+#define INCLUDED_SPECTROGRAM_COLOR_LUT_H
+
+#include <spectrogram/api.h>
+#include <QColor>
+#include <stdint.h>
+#include <vector>
+
+class QwtColorMap;
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Colour lookup table for one colour map and intensity range.
+ *
+ * \details
+ * Samples the colour map at SIZE evenly spaced intensities so a row of
+ * intensities can be turned into colours with one multiply and one
+ * table load per pixel, instead of a virtual QwtColorMap::rgb() call.
+ * The table is only rebuilt by update() when the range changes or after
+ * invalidate(), which must be called whenever the colour map changes.
+ */
+class SPECTROGRAM_API color_lut
+{
+public:
+  static const unsigned int SIZE = 1024;
+
+  color_lut();
+
+  void invalidate() { d_valid = false; }
+  //! Rebuilds the table from \p map if it is stale for [min, max]
+  void update(const QwtColorMap &map, double min, double max);
+
+  //! Quantizes \p n intensities to table indices
+  void quantize(uint16_t *index, const float *in, unsigned int n) const;
+  //! Maps \p n intensities to colours; safe to call from several threads
+  void map(QRgb *out, const float *in, unsigned int n) const;
+  //! Maps \p n intensities to colours and blends them over \p out with
+  //! \p alpha (0..255), as drawing them with that alpha would
+  void blend(QRgb *out, const float *in, unsigned int n, int alpha) const;
+
+private:
+  bool d_valid;
+  double d_min;
+  double d_max;
+  float d_scale;
+  std::vector<QRgb> d_table;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_COLOR_LUT_H */
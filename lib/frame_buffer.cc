@@ -0,0 +1,61 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "frame_buffer.h"
+#include <QMutexLocker>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+frame_buffer::frame_buffer() : d_valid(false) {}
+
+bool frame_buffer::fetch(const std::vector<double> &key, QImage &image) const
+{
+  QMutexLocker lock(&d_mutex);
+  if (!d_valid || (key != d_key))
+    return false;
+
+  image = d_front;
+  return true;
+}
+
+void frame_buffer::publish(const QImage &image, const std::vector<double> &key)
+{
+  QMutexLocker lock(&d_mutex);
+  d_front = image;
+  d_key = key;
+  d_valid = !image.isNull();
+}
+
+void frame_buffer::invalidate()
+{
+  QMutexLocker lock(&d_mutex);
+  d_valid = false;
+}
+
+} // namespace spectrogram
+} // namespace gr
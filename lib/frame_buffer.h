@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_FRAME_BUFFER_H
+#define INCLUDED_SPECTROGRAM_FRAME_BUFFER_H
+
+#include <spectrogram/api.h>
+#include <QImage>
+#include <QMutex>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Hands finished waterfall images from the render thread to the
+ * GUI thread.
+ *
+ * \details
+ * The renderer draws every frame into an image of its own and publishes
+ * it here, so the front image the GUI blits is never written while it is
+ * shown and the two threads only meet on a short lock to swap a shared
+ * QImage. A frame is tagged with the same kind of key as scroll_cache
+ * (maps, image size, intensity range); fetch() only returns it while the
+ * view still has that key.
+ */
+class SPECTROGRAM_API frame_buffer
+{
+public:
+  frame_buffer();
+
+  //! Copies the front image to \p image if it was rendered for \p key
+  bool fetch(const std::vector<double> &key, QImage &image) const;
+  //! Makes \p image, rendered for \p key, the front image
+  void publish(const QImage &image, const std::vector<double> &key);
+  void invalidate();
+
+private:
+  mutable QMutex d_mutex;
+  QImage d_front;
+  std::vector<double> d_key;
+  bool d_valid;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_FRAME_BUFFER_H */
@@ -18,13 +18,26 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include "color_lut.h"
+#include "frame_buffer.h"
+#include "scroll_cache.h"
 #include "qwt_color_map.h"
 #include "qwt_painter.h"
 #include "qwt_scale_map.h"
+#include <spectrogram/composite_mode.h>
 #include <spectrogram/plot_waterfall.h>
 #include <qimage.h>
+#include <qmutex.h>
 #include <qpainter.h>
 #include <qpen.h>
+#include <qthread.h>
+#include <algorithm>
+#include <vector>
+
+#if QT_VERSION >= 0x040400 && !defined(QT_NO_QFUTURE)
+#include <qfuture.h>
+#include <qtconcurrentrun.h>
+#endif
 
 #if QWT_VERSION < 0x060000
 #include "qwt_double_interval.h"
@@ -32,6 +45,521 @@
 
 typedef QVector<QRgb> QwtColorTable;
 
+// Bands shorter than this are not worth a thread of their own
+static const int MIN_BAND_LINES = 32;
+
+static unsigned int renderThreads(unsigned int requested)
+{
+    int threads = (requested > 0) ? (int)requested : QThread::idealThreadCount();
+    return (threads > 0) ? threads : 1;
+}
+
+// Splits the lines to render into horizontal bands, one per thread
+static void splitBands(const std::vector<gr::spectrogram::scroll_cache::line_span>& dirty,
+                       int width,
+                       unsigned int threads,
+                       std::vector<QRect>& bands)
+{
+    for (size_t span = 0; span < dirty.size(); span++) {
+        const int first = dirty[span].first;
+        const int lines = dirty[span].second;
+        const int parts =
+            std::max(1, std::min((int)threads, lines / MIN_BAND_LINES));
+        const int step = lines / parts;
+
+        for (int i = 0; i < parts; i++) {
+            const int height = (i == parts - 1) ? lines - i * step : step;
+            bands.push_back(QRect(0, first + i * step, width, height));
+        }
+    }
+}
+
+/*
+  Number of history rows drawn on image line y, ending at its own row:
+  the rows since the neighbouring line showing older ones. Keying a
+  line by its newest row keeps the spans valid when the scroll cache
+  moves lines.
+*/
+static int64_t lineRowCount(const std::vector<int64_t>& lineRows, int y)
+{
+    const int64_t row = lineRows[y];
+    int64_t older = -1;
+    if ((y > 0) && (lineRows[y - 1] < row))
+        older = lineRows[y - 1];
+    if ((y + 1 < (int)lineRows.size()) && (lineRows[y + 1] < row))
+        older = std::max(older, lineRows[y + 1]);
+
+    return ((row >= 0) && (older >= 0)) ? row - older : 1;
+}
+
+// Where the content of every line was shown before the latest rows came
+// in; left empty when the data was reset
+static void findPreviousRows(const WaterfallVectorData* data,
+                             const std::vector<int64_t>& lineRows,
+                             std::vector<int64_t>& previous)
+{
+    previous.clear();
+    if (data->getNumLinesToUpdate() < 0)
+        return;
+
+    previous.resize(lineRows.size());
+    for (size_t y = 0; y < lineRows.size(); y++)
+        previous[y] = data->getPreviousRow(lineRows[y]);
+}
+
+// Everything a frame depends on besides the history itself
+static void frameKey(const QwtScaleMap& xMap,
+                     const QwtScaleMap& yMap,
+                     const QRectF& area,
+                     const QSize& size,
+                     double minIntensity,
+                     double maxIntensity,
+                     std::vector<double>& key)
+{
+    key.clear();
+    key.push_back(xMap.s1());
+    key.push_back(xMap.s2());
+    key.push_back(xMap.p1());
+    key.push_back(xMap.p2());
+    key.push_back(yMap.s1());
+    key.push_back(yMap.s2());
+    key.push_back(yMap.p1());
+    key.push_back(yMap.p2());
+    key.push_back(area.x());
+    key.push_back(area.y());
+    key.push_back(area.width());
+    key.push_back(area.height());
+    key.push_back(size.width());
+    key.push_back(size.height());
+    key.push_back(minIntensity);
+    key.push_back(maxIntensity);
+}
+
+// One input of a composited image
+struct CompositeLayer {
+    CompositeLayer(WaterfallVectorData* data,
+                   const gr::spectrogram::color_lut* colors,
+                   int alpha)
+        : data(data), colors(colors), alpha(alpha)
+    {
+    }
+
+    WaterfallVectorData* data;
+    const gr::spectrogram::color_lut* colors;
+    int alpha;
+};
+
+/*
+  Fills one image line from every input at once: the colours of the
+  first input with the others blended over it, or the colours of the
+  highest intensity of all of them. \p scratch holds one line.
+*/
+static void compositeLine(const std::vector<CompositeLayer>& layers,
+                          int mode,
+                          int64_t row,
+                          int64_t rows,
+                          float* intensities,
+                          float* scratch,
+                          QRgb* line,
+                          int width)
+{
+    layers[0].data->getRasterLine(row, intensities, rows);
+
+    if (mode == gr::spectrogram::COMPOSITE_MAX) {
+        for (size_t i = 1; i < layers.size(); i++) {
+            layers[i].data->getRasterLine(row, scratch, rows);
+            for (int x = 0; x < width; x++)
+                intensities[x] = std::max(intensities[x], scratch[x]);
+        }
+        layers[0].colors->map(line, intensities, width);
+        return;
+    }
+
+    layers[0].colors->map(line, intensities, width);
+    for (size_t i = 1; i < layers.size(); i++) {
+        layers[i].data->getRasterLine(row, scratch, rows);
+        layers[i].colors->blend(line, scratch, width, layers[i].alpha);
+    }
+}
+
+/*
+  Band \p index of \p count equal bands stacked over \p canvasRect, and
+  the y map squeezing the whole canvas into it. The x map is unchanged,
+  so every band shares the frequency axis and zoom.
+*/
+static QRect stackedTile(const QRectF& canvasRect,
+                         int index,
+                         int count,
+                         const QwtScaleMap& yMap,
+                         QwtScaleMap& tileYMap)
+{
+    const double height = canvasRect.height() / count;
+    const int top = qRound(canvasRect.top() + index * height);
+    const int bottom = qRound(canvasRect.top() + (index + 1) * height);
+
+    tileYMap = yMap;
+    tileYMap.setPaintInterval(qRound(top + (yMap.p1() - canvasRect.top()) / count),
+                              qRound(top + (yMap.p2() - canvasRect.top()) / count));
+    return QRect(qRound(canvasRect.left()), top, qRound(canvasRect.width()), bottom - top);
+}
+
+// Separator and title of a stacked band
+static void drawTileCaption(QPainter* painter, const QRect& tile, const QString& caption)
+{
+    painter->setPen(QPen(Qt::white));
+    painter->drawLine(tile.topLeft(), tile.topRight());
+    painter->drawText(
+        tile.adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop, caption);
+}
+
+/*
+  Image and frame state shared by PlotWaterfall and WaterfallSpectrogram:
+  the scroll cache of the previous image, the render thread's frame, the
+  composited inputs and the band split of a render. Each item's
+  PrivateData derives from it and supplies what depends on its Qwt base
+  class: the full render, the lines the raster tables can't build, and
+  the colour map.
+*/
+class WaterfallImagePipeline
+{
+public:
+    WaterfallImagePipeline()
+        : data(NULL),
+          renderThreadCount(1),
+          rasterLines(false),
+          renderLock(NULL),
+          hasFrameMaps(false),
+          compositeMode(gr::spectrogram::COMPOSITE_NONE),
+          tileIndex(0),
+          tileCount(1)
+    {
+    }
+    virtual ~WaterfallImagePipeline() {}
+
+    QwtDoubleInterval intensityRange() const;
+
+    void invalidate();
+    void setRenderLock(QMutex* lock);
+    void setComposite(const int mode, const std::vector<WaterfallImagePipeline*>& inputs);
+    void setTile(const int index, const int count);
+
+    QImage frameImage(const QwtScaleMap& xMap,
+                      const QwtScaleMap& yMap,
+                      const QRectF& area,
+                      const QSize& size);
+    void renderFrame();
+
+    void beginRender(const QwtScaleMap& xMap,
+                     const QRect& rect,
+                     const QRectF& area,
+                     const QwtDoubleInterval& range,
+                     const bool lines);
+    void renderLines(QImage& image,
+                     const QwtScaleMap& xMap,
+                     const QwtScaleMap& yMap,
+                     const QRect& rect,
+                     const unsigned int threads);
+
+    WaterfallVectorData* data;
+
+    // Colours of the colour map over the intensity range
+    gr::spectrogram::color_lut colorTable;
+    unsigned int renderThreadCount;
+    // Lines are built from the tables precomputed by initRaster()
+    bool rasterLines;
+
+    // Previous image and the history row on each of its lines
+    gr::spectrogram::scroll_cache cache;
+    std::vector<int64_t> lineRows;
+    std::vector<int64_t> previousRows;
+    std::vector<double> imageKey;
+    std::vector<gr::spectrogram::scroll_cache::line_span> dirty;
+
+    WaterfallMetrics::sptr metrics;
+
+    // Latest frame and the geometry of the last draw, for the render thread
+    QMutex* renderLock;
+    gr::spectrogram::frame_buffer frame;
+    bool hasFrameMaps;
+    QwtScaleMap frameXMap;
+    QwtScaleMap frameYMap;
+    QRectF frameArea;
+    QSize frameSize;
+
+    // Other inputs rendered into this item's image, and their tables
+    // for the render in progress
+    int compositeMode;
+    std::vector<WaterfallImagePipeline*> layers;
+    std::vector<CompositeLayer> composite;
+
+    // Band of the canvas drawn to when stacked with other inputs
+    int tileIndex;
+    int tileCount;
+
+protected:
+    // Renders the item from scratch, bypassing the frame
+    virtual QImage renderNewImage(const QwtScaleMap& xMap,
+                                  const QwtScaleMap& yMap,
+                                  const QRectF& area,
+                                  const QSize& size) const = 0;
+    // Renders the lines of \p tile when rasterLines is off
+    virtual void renderTile(const QwtScaleMap& xMap,
+                            const QwtScaleMap& yMap,
+                            const QRect& rect,
+                            const QRect& tile,
+                            QImage* image) const = 0;
+    virtual const QwtColorMap& itemColorMap() const = 0;
+    virtual int itemAlpha() const = 0;
+
+private:
+    void renderBand(const QwtScaleMap& xMap,
+                    const QwtScaleMap& yMap,
+                    const QRect& rect,
+                    const QRect& tile,
+                    QImage* image) const;
+};
+
+QwtDoubleInterval WaterfallImagePipeline::intensityRange() const
+{
+#if QWT_VERSION < 0x060000
+    return data->range();
+#else
+    return data->interval(Qt::ZAxis);
+#endif
+}
+
+// Forces the next render to redraw every line instead of scrolling
+void WaterfallImagePipeline::invalidate()
+{
+    colorTable.invalidate();
+    cache.invalidate();
+    frame.invalidate();
+}
+
+/*
+  Hands rendering to a render thread that calls renderFrame() with
+  \p lock held; frameImage() then returns its frames and only renders
+  (taking \p lock) when the view changed. NULL renders on every draw.
+*/
+void WaterfallImagePipeline::setRenderLock(QMutex* lock)
+{
+    renderLock = lock;
+    frame.invalidate();
+}
+
+/*
+  Renders \p inputs, the other inputs' items, into this item's image
+  in the same pass over the pixels (see gr::spectrogram::composite_mode_t).
+  Only RGB colour maps in the usual orientation composite; other images
+  show this item's input alone.
+*/
+void WaterfallImagePipeline::setComposite(const int mode,
+                                          const std::vector<WaterfallImagePipeline*>& inputs)
+{
+    compositeMode = mode;
+    layers = inputs;
+    invalidate();
+}
+
+// Draws into band \p index of \p count bands stacked over the canvas
+void WaterfallImagePipeline::setTile(const int index, const int count)
+{
+    tileIndex = index;
+    tileCount = std::max(count, 1);
+}
+
+/*
+  The render thread's latest frame as long as the maps, size and
+  intensity range are unchanged since; otherwise renders one here with
+  the render lock held and lets the render thread follow the new view.
+*/
+QImage WaterfallImagePipeline::frameImage(const QwtScaleMap& xMap,
+                                          const QwtScaleMap& yMap,
+                                          const QRectF& area,
+                                          const QSize& size)
+{
+    if (renderLock == NULL)
+        return renderNewImage(xMap, yMap, area, size);
+
+    const QwtDoubleInterval range = intensityRange();
+    std::vector<double> key;
+    frameKey(xMap, yMap, area, size, range.minValue(), range.maxValue(), key);
+
+    QImage image;
+    if (frame.fetch(key, image))
+        return image;
+
+    QMutexLocker lock(renderLock);
+    frameXMap = xMap;
+    frameYMap = yMap;
+    frameArea = area;
+    frameSize = size;
+    hasFrameMaps = true;
+
+    image = renderNewImage(xMap, yMap, area, size);
+    frame.publish(image, key);
+    return image;
+}
+
+/*
+  Renders a frame for the maps of the last draw, if there was one, and
+  makes it the one frameImage() returns. Call with the render lock held.
+*/
+void WaterfallImagePipeline::renderFrame()
+{
+    if (!hasFrameMaps)
+        return;
+
+    const QwtDoubleInterval range = intensityRange();
+    std::vector<double> key;
+    frameKey(
+        frameXMap, frameYMap, frameArea, frameSize, range.minValue(), range.maxValue(), key);
+    frame.publish(renderNewImage(frameXMap, frameYMap, frameArea, frameSize), key);
+}
+
+/*
+  Sets up a render of \p area into \p rect, the image in paint
+  coordinates: the raster tables, the colour table, the inputs composited
+  into the image and the key the previous image must match to scroll.
+  \p lines builds the lines from the raster tables.
+*/
+void WaterfallImagePipeline::beginRender(const QwtScaleMap& xMap,
+                                         const QRect& rect,
+                                         const QRectF& area,
+                                         const QwtDoubleInterval& range,
+                                         const bool lines)
+{
+    data->initRaster(area, rect.size());
+    rasterLines = lines;
+
+    // The table is only rebuilt when the range or colour map changed
+    if (itemColorMap().format() == QwtColorMap::RGB)
+        colorTable.update(itemColorMap(), range.minValue(), range.maxValue());
+
+    imageKey.clear();
+    imageKey.push_back(xMap.s1());
+    imageKey.push_back(xMap.s2());
+    imageKey.push_back(xMap.p1());
+    imageKey.push_back(xMap.p2());
+    imageKey.push_back(rect.left());
+    imageKey.push_back(range.minValue());
+    imageKey.push_back(range.maxValue());
+
+    composite.clear();
+    if (!rasterLines || (compositeMode == gr::spectrogram::COMPOSITE_NONE) ||
+        layers.empty())
+        return;
+
+    // The layers are hidden items, so every one of them is composited:
+    // its table is sampled through rgb(), which any colour map format
+    // provides, and a layer without a valid range of its own is drawn
+    // with the base range
+    composite.push_back(CompositeLayer(data, &colorTable, 255));
+    for (size_t i = 0; i < layers.size(); i++) {
+        WaterfallImagePipeline* layer = layers[i];
+        QwtDoubleInterval layerRange = layer->intensityRange();
+        if (!layerRange.isValid())
+            layerRange = range;
+        layer->data->initRaster(area, rect.size());
+        layer->colorTable.update(
+            layer->itemColorMap(), layerRange.minValue(), layerRange.maxValue());
+        composite.push_back(
+            CompositeLayer(layer->data, &layer->colorTable, layer->itemAlpha()));
+        imageKey.push_back(layer->itemAlpha());
+        imageKey.push_back(layerRange.minValue());
+        imageKey.push_back(layerRange.maxValue());
+    }
+    imageKey.push_back(compositeMode);
+}
+
+/*
+  Copies the lines of \p image that only scrolled from the previous
+  image and renders the others, split into bands on \p threads threads
+  (0 for QThread::idealThreadCount()). lineRows must hold the history
+  row of every line.
+*/
+void WaterfallImagePipeline::renderLines(QImage& image,
+                                         const QwtScaleMap& xMap,
+                                         const QwtScaleMap& yMap,
+                                         const QRect& rect,
+                                         const unsigned int threads)
+{
+    findPreviousRows(data, lineRows, previousRows);
+    cache.prepare(image, lineRows, previousRows, imageKey, dirty);
+
+    if (!dirty.empty()) {
+        std::vector<QRect> bands;
+        splitBands(dirty, rect.width(), renderThreads(threads), bands);
+        image.bits(); // detach before the bands are written concurrently
+#if QT_VERSION >= 0x040400 && !defined(QT_NO_QFUTURE)
+        QList<QFuture<void> > futures;
+        for (size_t i = 0; i + 1 < bands.size(); i++) {
+            futures += QtConcurrent::run(this,
+                                         &WaterfallImagePipeline::renderBand,
+                                         xMap,
+                                         yMap,
+                                         rect,
+                                         bands[i],
+                                         &image);
+        }
+        renderBand(xMap, yMap, rect, bands.back(), &image);
+        for (int i = 0; i < futures.size(); i++)
+            futures[i].waitForFinished();
+#else
+        for (size_t i = 0; i < bands.size(); i++)
+            renderBand(xMap, yMap, rect, bands[i], &image);
+#endif
+    }
+
+    // The composited layers are hidden and never render themselves, so
+    // their scroll counts are reset here too
+    data->discardRaster();
+    data->setNumLinesToUpdate(0);
+    for (size_t i = 1; i < composite.size(); i++) {
+        composite[i].data->discardRaster();
+        composite[i].data->setNumLinesToUpdate(0);
+    }
+    cache.store(image);
+}
+
+/*
+  Renders the image lines of \p tile; \p rect is the image in paint
+  coordinates. Only reads shared state, so bands can run concurrently.
+*/
+void WaterfallImagePipeline::renderBand(const QwtScaleMap& xMap,
+                                        const QwtScaleMap& yMap,
+                                        const QRect& rect,
+                                        const QRect& tile,
+                                        QImage* image) const
+{
+    if (!rasterLines) {
+        renderTile(xMap, yMap, rect, tile, image);
+        return;
+    }
+
+    const int width = image->width();
+    std::vector<float> intensities(width);
+    if (!composite.empty()) {
+        std::vector<float> scratch(width);
+        for (int line = tile.top(); line <= tile.bottom(); line++) {
+            compositeLine(composite,
+                          compositeMode,
+                          lineRows[line],
+                          lineRowCount(lineRows, line),
+                          &intensities[0],
+                          &scratch[0],
+                          (QRgb*)image->scanLine(line),
+                          width);
+        }
+        return;
+    }
+
+    for (int line = tile.top(); line <= tile.bottom(); line++) {
+        data->getRasterLine(lineRows[line], &intensities[0], lineRowCount(lineRows, line));
+        colorTable.map((QRgb*)image->scanLine(line), &intensities[0], width);
+    }
+}
+
 class PlotWaterfallImage : public QImage
 {
     // This class hides some Qt3/Qt4 API differences
@@ -48,20 +576,77 @@ public:
     void initColorTable(const QImage& other) { setColorTable(other.colorTable()); }
 };
 
-class PlotWaterfall::PrivateData
+class PlotWaterfall::PrivateData : public WaterfallImagePipeline
 {
 public:
-    PrivateData()
+    explicit PrivateData(const PlotWaterfall* item)
+        : item(item), colorMap(new QwtLinearColorMap())
     {
-        data = NULL;
-        colorMap = new QwtLinearColorMap();
     }
     ~PrivateData() { delete colorMap; }
 
-    WaterfallVectorData* data;
+    const PlotWaterfall* item;
     QwtColorMap* colorMap;
+
+protected:
+    virtual QImage renderNewImage(const QwtScaleMap& xMap,
+                                  const QwtScaleMap& yMap,
+                                  const QRectF& area,
+                                  const QSize& size) const
+    {
+#if QWT_VERSION < 0x060000
+        return item->renderNewImage(xMap, yMap, area);
+#else
+        return item->renderNewImage(xMap, yMap, area, size);
+#endif
+    }
+    virtual void renderTile(const QwtScaleMap& xxMap,
+                            const QwtScaleMap& yyMap,
+                            const QRect& rect,
+                            const QRect& tile,
+                            QImage* image) const;
+    virtual const QwtColorMap& itemColorMap() const { return *colorMap; }
+    virtual int itemAlpha() const { return item->alpha(); }
 };
 
+// Maps every pixel of \p tile back to the data and through the colour map
+void PlotWaterfall::PrivateData::renderTile(const QwtScaleMap& xxMap,
+                                            const QwtScaleMap& yyMap,
+                                            const QRect& rect,
+                                            const QRect& tile,
+                                            QImage* image) const
+{
+    const QwtDoubleInterval range = intensityRange();
+    const int width = rect.width();
+
+    if (colorMap->format() == QwtColorMap::RGB) {
+        std::vector<float> intensities(width);
+
+        for (int line = tile.top(); line <= tile.bottom(); line++) {
+            const double ty = yyMap.invTransform(rect.top() + line);
+
+            for (int x = 0; x < width; x++) {
+                const double tx = xxMap.invTransform(rect.left() + x);
+                intensities[x] = data->value(tx, ty);
+            }
+
+            // Map the whole row through the table at once
+            colorTable.map((QRgb*)image->scanLine(line), &intensities[0], width);
+        }
+    } else if (colorMap->format() == QwtColorMap::Indexed) {
+        for (int line = tile.top(); line <= tile.bottom(); line++) {
+            const double ty = yyMap.invTransform(rect.top() + line);
+
+            unsigned char* pixel = image->scanLine(line);
+            for (int x = rect.left(); x <= rect.right(); x++) {
+                const double tx = xxMap.invTransform(x);
+
+                *pixel++ = colorMap->colorIndex(range, data->value(tx, ty));
+            }
+        }
+    }
+}
+
 /*!
   Sets the following item attributes:
   - QwtPlotItem::AutoScale: true
@@ -76,7 +661,7 @@ public:
 PlotWaterfall::PlotWaterfall(WaterfallVectorData* data, const QString& title)
     : QwtPlotRasterItem(title)
 {
-    d_data = new PrivateData();
+    d_data = new PrivateData(this);
     d_data->data = data;
 
     //    setCachePolicy(QwtPlotRasterItem::PaintCache);
@@ -112,6 +697,7 @@ void PlotWaterfall::setColorMap(const QwtColorMap& colorMap)
 #if QWT_VERSION < 0x060000
     d_data->colorMap = colorMap.copy();
 #endif
+    d_data->invalidate();
 
     invalidateCache();
     itemChanged();
@@ -123,6 +709,59 @@ void PlotWaterfall::setColorMap(const QwtColorMap& colorMap)
 */
 const QwtColorMap& PlotWaterfall::colorMap() const { return *d_data->colorMap; }
 
+void PlotWaterfall::invalidateImage() { d_data->invalidate(); }
+
+//! Records the time of every renderImage() in \p metrics
+void PlotWaterfall::setMetrics(WaterfallMetrics::sptr metrics) { d_data->metrics = metrics; }
+
+/*!
+  Hands rendering to a render thread that calls renderFrame() with
+  \p lock held; renderImage() then returns its frames and only renders
+  (taking \p lock) when the view changed. NULL renders on every draw.
+*/
+void PlotWaterfall::setRenderLock(QMutex* lock) { d_data->setRenderLock(lock); }
+
+/*!
+  Renders a frame for the maps of the last draw, if there was one, and
+  makes it the one renderImage() returns.
+*/
+void PlotWaterfall::renderFrame() { d_data->renderFrame(); }
+
+/*!
+  Renders \p layers, items of the other inputs, into this item's image
+  in the same pass over the pixels (see gr::spectrogram::composite_mode_t)
+  so they need not be drawn themselves. Only RGB colour maps in the usual
+  orientation composite; other images show this item's input alone.
+*/
+void PlotWaterfall::setComposite(const int mode, const std::vector<PlotWaterfall*>& layers)
+{
+    std::vector<WaterfallImagePipeline*> inputs;
+    for (size_t i = 0; i < layers.size(); i++)
+        inputs.push_back(layers[i]->d_data);
+    d_data->setComposite(mode, inputs);
+}
+
+/*!
+  Draws into band \p index of \p count bands stacked over the canvas,
+  captioned with the title; a count of 1 draws over the whole canvas.
+*/
+void PlotWaterfall::setTile(const int index, const int count)
+{
+    d_data->setTile(index, count);
+}
+
+/*!
+  Number of threads full redraws are split across; 0 uses
+  QThread::idealThreadCount(). Same meaning as
+  QwtPlotRasterItem::setRenderThreadCount() in Qwt 6.1.
+*/
+void PlotWaterfall::setRenderThreadCount(unsigned int numThreads)
+{
+    d_data->renderThreadCount = numThreads;
+}
+
+unsigned int PlotWaterfall::renderThreadCount() const { return d_data->renderThreadCount; }
+
 /*!
   \return Bounding rect of the data
   \sa QwtRasterData::boundingRect
@@ -161,6 +800,9 @@ QSize PlotWaterfall::rasterHint(const QwtDoubleRect& rect) const
   \return A QImage::Format_Indexed8 or QImage::Format_ARGB32 depending
   on the color map.
 
+  With a render lock set this is the render thread's latest frame,
+  unless the maps or the intensity range changed since.
+
   \sa QwtRasterData::intensity(), QwtColorMap::rgb(),
   QwtColorMap::colorIndex()
 */
@@ -168,16 +810,35 @@ QSize PlotWaterfall::rasterHint(const QwtDoubleRect& rect) const
 QImage PlotWaterfall::renderImage(const QwtScaleMap& xMap,
                                   const QwtScaleMap& yMap,
                                   const QwtDoubleRect& area) const
+{
+    return d_data->frameImage(xMap, yMap, area, QSize());
+}
 #else
 QImage PlotWaterfall::renderImage(const QwtScaleMap& xMap,
                                   const QwtScaleMap& yMap,
                                   const QRectF& area,
                                   const QSize& size) const
+{
+    return d_data->frameImage(xMap, yMap, area, size);
+}
+#endif
+
+#if QWT_VERSION < 0x060000
+QImage PlotWaterfall::renderNewImage(const QwtScaleMap& xMap,
+                                     const QwtScaleMap& yMap,
+                                     const QwtDoubleRect& area) const
+#else
+QImage PlotWaterfall::renderNewImage(const QwtScaleMap& xMap,
+                                     const QwtScaleMap& yMap,
+                                     const QRectF& area,
+                                     const QSize& size) const
 #endif
 {
     if (area.isEmpty())
         return QImage();
 
+    const gr::high_res_timer_type start = gr::high_res_timer_now();
+
 #if QWT_VERSION < 0x060000
     QRect rect = transform(xMap, yMap, area);
     const QSize res = d_data->data->rasterHint(area);
@@ -226,45 +887,26 @@ QImage PlotWaterfall::renderImage(const QwtScaleMap& xMap,
 
     PlotWaterfallImage image(rect.size(), d_data->colorMap->format());
 
-#if QWT_VERSION < 0x060000
-    const QwtDoubleInterval intensityRange = d_data->data->range();
-#else
-    const QwtInterval intensityRange = d_data->data->interval(Qt::ZAxis);
-#endif
+    const QwtDoubleInterval intensityRange = d_data->intensityRange();
     if (!intensityRange.isValid())
         return image;
 
-    d_data->data->initRaster(area, rect.size());
-
-    if (d_data->colorMap->format() == QwtColorMap::RGB) {
-        for (int y = rect.top(); y <= rect.bottom(); y++) {
-            const double ty = yyMap.invTransform(y);
-
-            QRgb* line = (QRgb*)image.scanLine(y - rect.top());
-            for (int x = rect.left(); x <= rect.right(); x++) {
-                const double tx = xxMap.invTransform(x);
-
-                *line++ =
-                    d_data->colorMap->rgb(intensityRange, d_data->data->value(tx, ty));
-            }
-        }
-    } else if (d_data->colorMap->format() == QwtColorMap::Indexed) {
+    d_data->beginRender(xxMap,
+                        rect,
+                        area,
+                        intensityRange,
+                        (d_data->colorMap->format() == QwtColorMap::RGB) &&
+                            (xxMap.p1() < xxMap.p2()) && (xxMap.s1() < xxMap.s2()));
+    if (d_data->colorMap->format() == QwtColorMap::Indexed)
         image.setColorTable(d_data->colorMap->colorTable(intensityRange));
 
-        for (int y = rect.top(); y <= rect.bottom(); y++) {
-            const double ty = yyMap.invTransform(y);
-
-            unsigned char* line = image.scanLine(y - rect.top());
-            for (int x = rect.left(); x <= rect.right(); x++) {
-                const double tx = xxMap.invTransform(x);
-
-                *line++ = d_data->colorMap->colorIndex(intensityRange,
-                                                       d_data->data->value(tx, ty));
-            }
-        }
-    }
+    // Reuse the lines of the previous image that only scrolled
+    std::vector<int64_t>& lineRows = d_data->lineRows;
+    lineRows.resize(rect.height());
+    for (int y = rect.top(); y <= rect.bottom(); y++)
+        lineRows[y - rect.top()] = d_data->data->rowIndex(yyMap.invTransform(y));
 
-    d_data->data->discardRaster();
+    d_data->renderLines(image, xxMap, yyMap, rect, renderThreadCount());
 
     // Mirror the image in case of inverted maps
 
@@ -274,6 +916,8 @@ QImage PlotWaterfall::renderImage(const QwtScaleMap& xMap,
         image = image.mirrored(hInvert, vInvert);
     }
 
+    if (d_data->metrics)
+        d_data->metrics->recordSince(gr::spectrogram::LATENCY_RENDER, start);
     return image;
 }
 
@@ -294,5 +938,186 @@ void PlotWaterfall::draw(QPainter* painter,
                          const QwtScaleMap& yMap,
                          const QRect& canvasRect) const
 {
-    QwtPlotRasterItem::draw(painter, xMap, yMap, canvasRect);
+    if (d_data->tileCount <= 1) {
+        QwtPlotRasterItem::draw(painter, xMap, yMap, canvasRect);
+        return;
+    }
+
+    QwtScaleMap tileYMap;
+    const QRect tile = stackedTile(
+        canvasRect, d_data->tileIndex, d_data->tileCount, yMap, tileYMap);
+
+    painter->save();
+    painter->setClipRect(tile, Qt::IntersectClip);
+    QwtPlotRasterItem::draw(painter, xMap, tileYMap, tile);
+    drawTileCaption(painter, tile, title().text());
+    painter->restore();
+}
+
+#if QWT_VERSION >= 0x060000
+class WaterfallSpectrogram::PrivateData : public WaterfallImagePipeline
+{
+public:
+    explicit PrivateData(const WaterfallSpectrogram* item) : item(item) {}
+
+    const WaterfallSpectrogram* item;
+
+protected:
+    virtual QImage renderNewImage(const QwtScaleMap& xMap,
+                                  const QwtScaleMap& yMap,
+                                  const QRectF& area,
+                                  const QSize& size) const
+    {
+        return item->renderNewImage(xMap, yMap, area, size);
+    }
+    virtual void renderTile(const QwtScaleMap& xMap,
+                            const QwtScaleMap& yMap,
+                            const QRect&,
+                            const QRect& tile,
+                            QImage* image) const
+    {
+        item->renderTile(xMap, yMap, tile, image);
+    }
+    virtual const QwtColorMap& itemColorMap() const { return *item->colorMap(); }
+    virtual int itemAlpha() const { return item->alpha(); }
+};
+
+WaterfallSpectrogram::WaterfallSpectrogram(WaterfallVectorData* data, const QString& title)
+    : QwtPlotSpectrogram(title)
+{
+    d_data = new PrivateData(this);
+    d_data->data = data;
+    setData(data);
+}
+
+WaterfallSpectrogram::~WaterfallSpectrogram() { delete d_data; }
+
+void WaterfallSpectrogram::invalidateImage() { d_data->invalidate(); }
+
+void WaterfallSpectrogram::setMetrics(WaterfallMetrics::sptr metrics)
+{
+    d_data->metrics = metrics;
+}
+
+void WaterfallSpectrogram::setRenderLock(QMutex* lock) { d_data->setRenderLock(lock); }
+
+void WaterfallSpectrogram::renderFrame() { d_data->renderFrame(); }
+
+/*!
+  Renders \p layers, items of the other inputs, into this item's image
+  in the same pass over the pixels (see gr::spectrogram::composite_mode_t)
+  so they need not be drawn themselves.
+*/
+void WaterfallSpectrogram::setComposite(const int mode,
+                                        const std::vector<WaterfallSpectrogram*>& layers)
+{
+    std::vector<WaterfallImagePipeline*> inputs;
+    for (size_t i = 0; i < layers.size(); i++)
+        inputs.push_back(layers[i]->d_data);
+    d_data->setComposite(mode, inputs);
 }
+
+void WaterfallSpectrogram::setTile(const int index, const int count)
+{
+    d_data->setTile(index, count);
+}
+
+/*!
+  Draws over the whole canvas, or squeezed into its band of the canvas
+  when stacked (see setTile()) so the image is only as large as the band.
+*/
+void WaterfallSpectrogram::draw(QPainter* painter,
+                                const QwtScaleMap& xMap,
+                                const QwtScaleMap& yMap,
+                                const QRectF& canvasRect) const
+{
+    if (d_data->tileCount <= 1) {
+        QwtPlotSpectrogram::draw(painter, xMap, yMap, canvasRect);
+        return;
+    }
+
+    QwtScaleMap tileYMap;
+    const QRect tile = stackedTile(
+        canvasRect, d_data->tileIndex, d_data->tileCount, yMap, tileYMap);
+
+    painter->save();
+    painter->setClipRect(tile, Qt::IntersectClip);
+    QwtPlotSpectrogram::draw(painter, xMap, tileYMap, tile);
+    drawTileCaption(painter, tile, title().text());
+    painter->restore();
+}
+
+#if QWT_VERSION < 0x060100
+void WaterfallSpectrogram::setRenderThreadCount(unsigned int numThreads)
+{
+    d_data->renderThreadCount = numThreads;
+}
+
+unsigned int WaterfallSpectrogram::renderThreadCount() const
+{
+    return d_data->renderThreadCount;
+}
+#endif
+
+/*!
+  \brief Render an image, scrolling the previous one when possible.
+
+  Lines still showing a row of the previous image are copied from it;
+  only the remaining ones are rendered, split into bands on
+  renderThreadCount() threads. RGB images in the usual orientation are
+  built from the raster tables and the colour table; anything else goes
+  through QwtPlotSpectrogram::renderTile().
+
+  With a render lock set, the render thread's latest frame is returned
+  instead as long as the maps, size and intensity range are unchanged.
+*/
+QImage WaterfallSpectrogram::renderImage(const QwtScaleMap& xMap,
+                                         const QwtScaleMap& yMap,
+                                         const QRectF& area,
+                                         const QSize& imageSize) const
+{
+    return d_data->frameImage(xMap, yMap, area, imageSize);
+}
+
+QImage WaterfallSpectrogram::renderNewImage(const QwtScaleMap& xMap,
+                                            const QwtScaleMap& yMap,
+                                            const QRectF& area,
+                                            const QSize& imageSize) const
+{
+    const QwtInterval intensityRange = d_data->intensityRange();
+    if (imageSize.isEmpty() || !intensityRange.isValid() ||
+        !testDisplayMode(QwtPlotSpectrogram::ImageMode))
+        return QwtPlotSpectrogram::renderImage(xMap, yMap, area, imageSize);
+
+    const gr::high_res_timer_type start = gr::high_res_timer_now();
+    QImage image(imageSize,
+                 colorMap()->format() == QwtColorMap::RGB ? QImage::Format_ARGB32
+                                                          : QImage::Format_Indexed8);
+    if (colorMap()->format() == QwtColorMap::Indexed)
+        image.setColorTable(colorMap()->colorTable(intensityRange));
+
+    const QRect rect(QPoint(0, 0), imageSize);
+    d_data->beginRender(xMap,
+                        rect,
+                        area,
+                        intensityRange,
+                        (colorMap()->format() == QwtColorMap::RGB) &&
+                            (xMap.invTransform(0) < xMap.invTransform(imageSize.width())) &&
+                            (yMap.invTransform(0) > yMap.invTransform(imageSize.height())));
+
+    std::vector<int64_t>& lineRows = d_data->lineRows;
+    if (d_data->rasterLines) {
+        lineRows = d_data->data->getRasterRows();
+    } else {
+        lineRows.resize(imageSize.height());
+        for (int y = 0; y < imageSize.height(); y++)
+            lineRows[y] = d_data->data->rowIndex(yMap.invTransform(y));
+    }
+
+    d_data->renderLines(image, xMap, yMap, rect, renderThreadCount());
+
+    if (d_data->metrics)
+        d_data->metrics->recordSince(gr::spectrogram::LATENCY_RENDER, start);
+    return image;
+}
+#endif
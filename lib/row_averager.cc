@@ -0,0 +1,163 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "row_averager.h"
+#include <volk/volk.h>
+#include <algorithm>
+#include <cstring>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+row_averager::row_averager(unsigned int vlen, unsigned int nconnections)
+    : d_vlen(vlen),
+      d_averager(vlen),
+      d_integrated(0),
+      d_integrating(false),
+      d_restart(false),
+      d_last_time(0)
+{
+  for (unsigned int n = 0; n < nconnections; n++)
+  {
+    d_rows.push_back((float *)volk_malloc(d_vlen * sizeof(float), volk_get_alignment()));
+    memset(d_rows[n], 0, d_vlen * sizeof(float));
+  }
+}
+
+row_averager::~row_averager()
+{
+  for (size_t n = 0; n < d_rows.size(); n++)
+    volk_free(d_rows[n]);
+}
+
+void row_averager::clear()
+{
+  d_integrated = 0;
+  for (size_t n = 0; n < d_rows.size(); n++)
+    memset(d_rows[n], 0, d_vlen * sizeof(float));
+}
+
+void row_averager::process(const gr_vector_const_void_star &input_items,
+                           unsigned int nvecs,
+                           average_mode_t mode,
+                           int count,
+                           float alpha,
+                           bool restart,
+                           gr::high_res_timer_type update_time,
+                           handler &h)
+{
+  restart = restart || d_restart;
+  d_restart = false;
+
+  if (count > 0)
+  {
+    // The dB state of the averages is no start for the power sums
+    integrate(input_items, nvecs, count, restart || !d_integrating, h);
+    d_integrating = true;
+    return;
+  }
+
+  // Holds start over from the first new vector; the exponential
+  // average just carries on, unless the state is left over from
+  // integrating
+  const bool reload =
+      (nvecs > 0) && ((restart && (mode != AVERAGE_EXPONENTIAL)) || d_integrating);
+  if (nvecs > 0)
+    d_integrating = false;
+
+  // Fold every input vector into the per-connection state in one pass
+  for (size_t n = 0; n < d_rows.size(); n++)
+  {
+    const float *in = (const float *)input_items[n];
+    unsigned int left = nvecs;
+
+    if (reload)
+    {
+      memcpy(d_rows[n], in, d_vlen * sizeof(float));
+      in += d_vlen;
+      left--;
+    }
+
+    switch (mode)
+    {
+    case AVERAGE_PEAK_HOLD:
+    case AVERAGE_MAX_HOLD:
+      d_averager.max_hold(d_rows[n], in, left);
+      break;
+    case AVERAGE_MIN_HOLD:
+      d_averager.min_hold(d_rows[n], in, left);
+      break;
+    default:
+      d_averager.exponential(d_rows[n], in, left, alpha);
+      break;
+    }
+  }
+
+  // Only the decimated result is emitted, at the update rate
+  const gr::high_res_timer_type now = gr::high_res_timer_now();
+  if (now - d_last_time > update_time)
+  {
+    d_last_time = now;
+    h.emit_row();
+    d_restart = (mode == AVERAGE_PEAK_HOLD);
+  }
+}
+
+void row_averager::integrate(const gr_vector_const_void_star &input_items,
+                             unsigned int nvecs,
+                             int count,
+                             bool restart,
+                             handler &h)
+{
+  if (restart)
+    clear();
+
+  unsigned int i = 0;
+  while (i < nvecs)
+  {
+    const int chunk = std::min((int)(nvecs - i), count - d_integrated);
+    for (size_t n = 0; n < d_rows.size(); n++)
+      d_averager.power_accumulate(
+          d_rows[n], ((const float *)input_items[n]) + i * d_vlen, chunk);
+
+    i += chunk;
+    d_integrated += chunk;
+    if (d_integrated < count)
+      break;
+
+    // A full row: the accumulators are turned into the mean in dB in
+    // place, as they are cleared for the next row anyway
+    for (size_t n = 0; n < d_rows.size(); n++)
+      d_averager.power_mean_db(d_rows[n], d_rows[n], count);
+    d_last_time = gr::high_res_timer_now();
+    h.emit_row();
+
+    clear();
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,98 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_ROW_AVERAGER_H
+#define INCLUDED_SPECTROGRAM_ROW_AVERAGER_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/average_mode.h>
+#include <gnuradio/high_res_timer.h>
+#include <gnuradio/types.h>
+#include "vector_averager.h"
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Turns the input vectors of a waterfall sink into rows.
+ *
+ * \details
+ * Holds one state vector per connection. With an integration count,
+ * every row is the mean power of exactly that many vectors. Otherwise
+ * the vectors are folded in with the average or hold mode, and a row
+ * is taken at most once per update time. Completed rows are handed to
+ * a handler, which reads them from rows() before process() goes on.
+ */
+class SPECTROGRAM_API row_averager
+{
+public:
+  class handler
+  {
+  public:
+    virtual ~handler() {}
+    //! rows() holds a finished row of every connection
+    virtual void emit_row() = 0;
+  };
+
+  row_averager(unsigned int vlen, unsigned int nconnections);
+  ~row_averager();
+
+  const std::vector<float *> &rows() const { return d_rows; }
+  //! When the last row was emitted
+  gr::high_res_timer_type last_time() const { return d_last_time; }
+
+  /*!
+   * Folds \p nvecs vectors of every input. \p restart drops the state
+   * first; a peak hold restarts on its own after each row.
+   */
+  void process(const gr_vector_const_void_star &input_items,
+               unsigned int nvecs,
+               average_mode_t mode,
+               int count,
+               float alpha,
+               bool restart,
+               gr::high_res_timer_type update_time,
+               handler &h);
+
+private:
+  unsigned int d_vlen;
+  std::vector<float *> d_rows;
+  vector_averager d_averager;
+  int d_integrated;
+  // The last call integrated, so d_rows holds power sums, not dB
+  bool d_integrating;
+  bool d_restart;
+  gr::high_res_timer_type d_last_time;
+
+  void clear();
+  void integrate(const gr_vector_const_void_star &input_items,
+                 unsigned int nvecs,
+                 int count,
+                 bool restart,
+                 handler &h);
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_ROW_AVERAGER_H */
@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "row_stats.h"
+#include <algorithm>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+// Histogram classes cover HIST_MIN .. HIST_MIN + HIST_BINS * HIST_STEP dB;
+// anything outside is counted in the first or last class
+static const float HIST_MIN = -200.0f;
+static const float HIST_STEP = 0.25f;
+static const unsigned int HIST_BINS = 1200;
+
+// Rescale the weights well before they could overflow
+static const double MAX_WEIGHT = 1e100;
+
+row_stats::row_stats(float floor_percentile, float peak_percentile, float smoothing)
+    : d_floor_percentile(std::max(0.0f, std::min(floor_percentile, 1.0f))),
+      d_peak_percentile(std::max(0.0f, std::min(peak_percentile, 1.0f))),
+      d_growth(1.0 / (1.0 - std::max(0.0f, std::min(smoothing, 0.5f)))),
+      d_floor(0), d_peak(0), d_hist(HIST_BINS)
+{
+  reset();
+}
+
+void row_stats::reset()
+{
+  std::fill(d_hist.begin(), d_hist.end(), 0.0);
+  d_weight = 1.0;
+  d_total = 0.0;
+}
+
+void row_stats::update(const float *row, unsigned int n)
+{
+  if (n == 0)
+    return;
+
+  // Weighting each new row up instead of decaying the histogram keeps
+  // the update at one add per bin
+  if (d_total > 0.0)
+    d_weight *= d_growth;
+  if (d_weight > MAX_WEIGHT)
+  {
+    for (unsigned int i = 0; i < HIST_BINS; i++)
+      d_hist[i] /= d_weight;
+    d_total /= d_weight;
+    d_weight = 1.0;
+  }
+
+  const float scale = 1.0f / HIST_STEP;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    // Written so that NaN lands in the first class; clamped before the
+    // cast so +inf lands in the last
+    const float x = (row[i] - HIST_MIN) * scale;
+    const unsigned int bin =
+        (x >= 0.0f) ? (unsigned int)std::min(x, float(HIST_BINS - 1)) : 0;
+    d_hist[bin] += d_weight;
+  }
+  d_total += n * d_weight;
+
+  // One cumulative pass finds both percentiles
+  const double floor_target = d_floor_percentile * d_total;
+  const double peak_target = d_peak_percentile * d_total;
+  double below = 0.0;
+  bool have_floor = false;
+  for (unsigned int i = 0; i < HIST_BINS; i++)
+  {
+    const double above = below + d_hist[i];
+    if (!have_floor && (above >= floor_target) && (d_hist[i] > 0.0))
+    {
+      d_floor = percentile_at(i, below, floor_target);
+      have_floor = true;
+    }
+    if ((above >= peak_target) && (d_hist[i] > 0.0))
+    {
+      d_peak = percentile_at(i, below, peak_target);
+      break;
+    }
+    below = above;
+  }
+}
+
+float row_stats::percentile_at(unsigned int bin, double below, double target) const
+{
+  const double fraction = std::max(0.0, std::min((target - below) / d_hist[bin], 1.0));
+  return HIST_MIN + (bin + fraction) * HIST_STEP;
+}
+
+} // namespace spectrogram
+} // namespace gr
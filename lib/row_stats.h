@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_ROW_STATS_H
+#define INCLUDED_SPECTROGRAM_ROW_STATS_H
+
+#include <spectrogram/api.h>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Intensity statistics of the rows of one connection.
+ *
+ * \details
+ * update() adds every bin of a row to a histogram of recent intensities
+ * (HIST_STEP dB classes) in which each row weighs 1 / (1 - smoothing)
+ * times as much as the one before, so older rows fade out without ever
+ * being rescanned. The noise floor and the peak level
+ * are the \p floor_percentile and \p peak_percentile of that histogram,
+ * which a single spike or busy row barely moves.
+ */
+class SPECTROGRAM_API row_stats
+{
+public:
+  row_stats(float floor_percentile = 0.1f,
+            float peak_percentile = 0.999f,
+            float smoothing = 0.125f);
+
+  void update(const float *row, unsigned int n);
+  //! Forgets every row seen so far
+  void reset();
+
+  float noise_floor() const { return d_floor; }
+  float peak_level() const { return d_peak; }
+
+private:
+  float d_floor_percentile;
+  float d_peak_percentile;
+  double d_growth;
+  double d_weight;
+  double d_total;
+  float d_floor;
+  float d_peak;
+  std::vector<double> d_hist;
+
+  float percentile_at(unsigned int bin, double below, double target) const;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_ROW_STATS_H */
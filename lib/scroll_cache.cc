@@ -0,0 +1,109 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "scroll_cache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+scroll_cache::scroll_cache() : d_valid(false) {}
+
+static void add_dirty(std::vector<scroll_cache::line_span> &dirty, int line)
+{
+  if (!dirty.empty() && (dirty.back().first + dirty.back().second == line))
+    dirty.back().second++;
+  else
+    dirty.push_back(scroll_cache::line_span(line, 1));
+}
+
+void scroll_cache::prepare(QImage &image,
+                           const std::vector<int64_t> &rows,
+                           const std::vector<int64_t> &previous,
+                           const std::vector<double> &key,
+                           std::vector<line_span> &dirty)
+{
+  dirty.clear();
+
+  const int height = image.height();
+  const bool reuse = d_valid && ((int)previous.size() == height) &&
+                     (image.size() == d_image.size()) &&
+                     (image.format() == d_image.format()) &&
+                     ((int)rows.size() == height) && (rows == d_rows) && (key == d_key);
+
+  d_rows = rows;
+  d_key = key;
+
+  if (!reuse)
+  {
+    if (height > 0)
+      dirty.push_back(line_span(0, height));
+    return;
+  }
+
+  if (image.format() == QImage::Format_Indexed8)
+    image.setColorTable(d_image.colorTable());
+
+  // Where each history row was drawn last time
+  int64_t nrows = 0;
+  for (int y = 0; y < height; y++)
+    nrows = std::max(nrows, rows[y] + 1);
+  d_line_of_row.assign(nrows, -1);
+  for (int y = 0; y < height; y++)
+  {
+    if (rows[y] >= 0)
+      d_line_of_row[rows[y]] = y;
+  }
+
+  const int bytes = std::min(image.bytesPerLine(), d_image.bytesPerLine());
+  for (int y = 0; y < height; y++)
+  {
+    // Lines outside the data never change; the others now show what
+    // their previous row showed
+    int src = y;
+    if (rows[y] >= 0)
+    {
+      const int64_t old_row = previous[y];
+      src = ((old_row >= 0) && (old_row < nrows)) ? d_line_of_row[old_row] : -1;
+    }
+
+    if (src < 0)
+      add_dirty(dirty, y);
+    else
+      memcpy(image.scanLine(y), d_image.constScanLine(src), bytes);
+  }
+}
+
+void scroll_cache::store(const QImage &image)
+{
+  d_image = image;
+  d_valid = !image.isNull();
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,88 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_SCROLL_CACHE_H
+#define INCLUDED_SPECTROGRAM_SCROLL_CACHE_H
+
+#include <spectrogram/api.h>
+#include <QImage>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Keeps the last rendered waterfall image so a new one can be
+ * built by scrolling it.
+ *
+ * \details
+ * The caller describes an image by the history row shown on each of its
+ * lines (-1 for lines outside the data) and by a key holding everything
+ * else the pixels depend on (x mapping, intensity range, ...). When the
+ * lines and key match the previous image and rows have only scrolled in,
+ * prepare() copies every line whose row is still displayed from the
+ * line that showed the same content before, and returns only the
+ * remaining lines as dirty. Anything else (zoom, resize, colour map or
+ * range change, reset) makes the whole image dirty.
+ */
+class SPECTROGRAM_API scroll_cache
+{
+public:
+  //! A run of image lines: first line and number of lines
+  typedef std::pair<int, int> line_span;
+
+  scroll_cache();
+
+  void invalidate() { d_valid = false; }
+
+  /*!
+   * \param image new image, already sized and formatted
+   * \param rows history row of each line of \p image
+   * \param previous for each line, the row its content was shown at in
+   *        the previous image (-1 if it was not); empty if unknown
+   * \param key values the pixels depend on besides the rows
+   * \param dirty receives the line runs that still have to be rendered
+   */
+  void prepare(QImage &image,
+               const std::vector<int64_t> &rows,
+               const std::vector<int64_t> &previous,
+               const std::vector<double> &key,
+               std::vector<line_span> &dirty);
+
+  //! Keeps \p image, fully rendered, as the base for the next prepare()
+  void store(const QImage &image);
+
+private:
+  bool d_valid;
+  QImage d_image;
+  std::vector<int64_t> d_rows;
+  std::vector<double> d_key;
+  std::vector<int> d_line_of_row;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_SCROLL_CACHE_H */
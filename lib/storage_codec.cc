@@ -0,0 +1,116 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "storage_codec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+const double storage_codec::DEFAULT_RANGE = 204.0;
+
+storage_codec::storage_codec(int type, double offset, double scale)
+    : d_type(type), d_offset(offset), d_scale(scale)
+{
+  if (d_scale <= 0)
+    d_scale = DEFAULT_RANGE / ((type == STORAGE_UINT16) ? 65535.0 : 255.0);
+}
+
+size_t storage_codec::sample_size() const
+{
+  switch (d_type)
+  {
+  case STORAGE_UINT16:
+    return sizeof(uint16_t);
+  case STORAGE_UINT8:
+    return sizeof(uint8_t);
+  default:
+    return sizeof(float);
+  }
+}
+
+// Clamp in the float domain before the integer cast: NaN (e.g. log10 of a
+// zero power bin) maps to code 0, out-of-range values saturate.
+static inline double quantize_code(double code, double max_code)
+{
+  if (!(code > 0.0))
+    return 0.0;
+  return std::min(code, max_code);
+}
+
+void storage_codec::encode(void *out, const float *in, size_t n) const
+{
+  const double inv_scale = 1.0 / d_scale;
+
+  switch (d_type)
+  {
+  case STORAGE_UINT16:
+  {
+    uint16_t *dst = (uint16_t *)out;
+    for (size_t i = 0; i < n; i++)
+    {
+      dst[i] = (uint16_t)quantize_code((in[i] - d_offset) * inv_scale + 0.5, 65535.0);
+    }
+    break;
+  }
+  case STORAGE_UINT8:
+  {
+    uint8_t *dst = (uint8_t *)out;
+    for (size_t i = 0; i < n; i++)
+    {
+      dst[i] = (uint8_t)quantize_code((in[i] - d_offset) * inv_scale + 0.5, 255.0);
+    }
+    break;
+  }
+  default:
+    memcpy(out, in, n * sizeof(float));
+    break;
+  }
+}
+
+void storage_codec::decode(float *out, const void *in, size_t n) const
+{
+  switch (d_type)
+  {
+  case STORAGE_UINT16:
+    for (size_t i = 0; i < n; i++)
+      out[i] = (float)(d_offset + ((const uint16_t *)in)[i] * d_scale);
+    break;
+  case STORAGE_UINT8:
+    for (size_t i = 0; i < n; i++)
+      out[i] = (float)(d_offset + ((const uint8_t *)in)[i] * d_scale);
+    break;
+  default:
+    memcpy(out, in, n * sizeof(float));
+    break;
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+
+#ifndef INCLUDED_SPECTROGRAM_STORAGE_CODEC_H
+#define INCLUDED_SPECTROGRAM_STORAGE_CODEC_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/storage_type.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Converts rows of intensities to and from a storage_type_t.
+ *
+ * \details
+ * The one place the quantized formats are encoded and decoded, shared by
+ * the waterfall history and the recorder so a reloaded row matches the
+ * display. A scale of 0 or less spreads DEFAULT_RANGE dB above the offset
+ * over the codes of the type (0.8 dB per step for STORAGE_UINT8).
+ */
+class SPECTROGRAM_API storage_codec
+{
+public:
+  static const double DEFAULT_RANGE;
+
+  storage_codec(int type = STORAGE_FLOAT, double offset = 0.0, double scale = 0.0);
+
+  int type() const { return d_type; }
+  double offset() const { return d_offset; }
+  double scale() const { return d_scale; }
+  //! Bytes per stored sample
+  size_t sample_size() const;
+
+  void encode(void *out, const float *in, size_t n) const;
+  void decode(float *out, const void *in, size_t n) const;
+
+  //! Decodes sample \p index of \p in
+  double sample(const void *in, size_t index) const
+  {
+    switch (d_type)
+    {
+    case STORAGE_UINT16:
+      return d_offset + ((const uint16_t *)in)[index] * d_scale;
+    case STORAGE_UINT8:
+      return d_offset + ((const uint8_t *)in)[index] * d_scale;
+    default:
+      return ((const float *)in)[index];
+    }
+  }
+
+private:
+  int d_type;
+  double d_offset;
+  double d_scale;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_STORAGE_CODEC_H */
@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vector_averager.h"
+#include <volk/volk.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+// 8 KiB of floats per chunk; a multiple of every VOLK alignment so each
+// chunk keeps the alignment of the buffer it was cut from
+static const unsigned int CHUNK_POINTS = 2048;
+
+// 10^(x/10) == exp(x * ln(10)/10) and 10*log10(x) == log2(x) * 10*log10(2)
+static const float DB_TO_EXP = float(M_LN10 / 10.0);
+static const float LOG2_TO_DB = float(10.0 * M_LN2 / M_LN10);
+
+vector_averager::vector_averager(unsigned int vlen) : d_vlen(vlen)
+{
+  d_scratch = (float *)volk_malloc(CHUNK_POINTS * sizeof(float), volk_get_alignment());
+}
+
+vector_averager::~vector_averager() { volk_free(d_scratch); }
+
+void vector_averager::exponential(float *avg,
+                                  const float *in,
+                                  unsigned int nvecs,
+                                  float alpha)
+{
+  if (nvecs == 0)
+    return;
+
+  // Only the newest vector survives a full-weight average
+  if (alpha >= 1.0f)
+  {
+    memcpy(avg, in + (nvecs - 1) * d_vlen, d_vlen * sizeof(float));
+    return;
+  }
+
+  // avg += alpha * (in - avg)
+  for (unsigned int offset = 0; offset < d_vlen; offset += CHUNK_POINTS)
+  {
+    const unsigned int n = std::min(CHUNK_POINTS, d_vlen - offset);
+    float *a = avg + offset;
+    for (unsigned int v = 0; v < nvecs; v++)
+    {
+      volk_32f_x2_subtract_32f(d_scratch, in + v * d_vlen + offset, a, n);
+      volk_32f_s32f_multiply_32f(d_scratch, d_scratch, alpha, n);
+      volk_32f_x2_add_32f(a, a, d_scratch, n);
+    }
+  }
+}
+
+void vector_averager::max_hold(float *acc, const float *in, unsigned int nvecs)
+{
+  for (unsigned int offset = 0; offset < d_vlen; offset += CHUNK_POINTS)
+  {
+    const unsigned int n = std::min(CHUNK_POINTS, d_vlen - offset);
+    for (unsigned int v = 0; v < nvecs; v++)
+      volk_32f_x2_max_32f(acc + offset, acc + offset, in + v * d_vlen + offset, n);
+  }
+}
+
+void vector_averager::min_hold(float *acc, const float *in, unsigned int nvecs)
+{
+  for (unsigned int offset = 0; offset < d_vlen; offset += CHUNK_POINTS)
+  {
+    const unsigned int n = std::min(CHUNK_POINTS, d_vlen - offset);
+    for (unsigned int v = 0; v < nvecs; v++)
+      volk_32f_x2_min_32f(acc + offset, acc + offset, in + v * d_vlen + offset, n);
+  }
+}
+
+void vector_averager::power_accumulate(float *acc, const float *in, unsigned int nvecs)
+{
+  for (unsigned int offset = 0; offset < d_vlen; offset += CHUNK_POINTS)
+  {
+    const unsigned int n = std::min(CHUNK_POINTS, d_vlen - offset);
+    for (unsigned int v = 0; v < nvecs; v++)
+    {
+      volk_32f_s32f_multiply_32f(d_scratch, in + v * d_vlen + offset, DB_TO_EXP, n);
+      // the exact kernel: expfast is off by several percent and returns
+      // garbage for the very negative (or -inf) levels of empty bins
+      volk_32f_exp_32f(d_scratch, d_scratch, n);
+      volk_32f_x2_add_32f(acc + offset, acc + offset, d_scratch, n);
+    }
+  }
+}
+
+void vector_averager::power_mean_db(float *out, const float *acc, unsigned int count)
+{
+  const float scale = 1.0f / std::max(count, 1u);
+
+  for (unsigned int offset = 0; offset < d_vlen; offset += CHUNK_POINTS)
+  {
+    const unsigned int n = std::min(CHUNK_POINTS, d_vlen - offset);
+    volk_32f_s32f_multiply_32f(d_scratch, acc + offset, scale, n);
+    volk_32f_log2_32f(d_scratch, d_scratch, n);
+    volk_32f_s32f_multiply_32f(out + offset, d_scratch, LOG2_TO_DB, n);
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,71 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef INCLUDED_SPECTROGRAM_VECTOR_AVERAGER_H
+#define INCLUDED_SPECTROGRAM_VECTOR_AVERAGER_H
+
+#include <spectrogram/api.h>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief VOLK kernels for the per-bin averaging done by the sink.
+ *
+ * \details
+ * Each call folds \p nvecs consecutive input vectors into a state
+ * vector. The work is split into cache-sized chunks of bins, and every
+ * input vector is applied to a chunk before moving on, so the state
+ * chunk stays in L1 while the input block is streamed exactly once.
+ */
+class SPECTROGRAM_API vector_averager
+{
+public:
+  vector_averager(unsigned int vlen);
+  ~vector_averager();
+
+  unsigned int vlen() const { return d_vlen; }
+
+  //! avg = (1 - alpha) * avg + alpha * in, for each input vector in turn
+  void exponential(float *avg, const float *in, unsigned int nvecs, float alpha);
+
+  //! acc = max(acc, in) over all input vectors
+  void max_hold(float *acc, const float *in, unsigned int nvecs);
+
+  //! acc = min(acc, in) over all input vectors
+  void min_hold(float *acc, const float *in, unsigned int nvecs);
+
+  //! acc += 10^(in / 10) over all input vectors given in dB
+  void power_accumulate(float *acc, const float *in, unsigned int nvecs);
+
+  //! out = 10 * log10(acc / count), the mean power in dB
+  void power_mean_db(float *out, const float *acc, unsigned int count);
+
+private:
+  unsigned int d_vlen;
+  float *d_scratch;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_VECTOR_AVERAGER_H */
@@ -0,0 +1,308 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "storage_codec.h"
+#include <spectrogram/waterfall_file.h>
+#include <gnuradio/high_res_timer.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+static size_t sample_size(uint32_t storage) { return storage_codec(storage).sample_size(); }
+
+static uint32_t record_size(uint32_t nchannels, uint32_t vec_points, uint32_t storage)
+{
+  const uint64_t bytes = sizeof(waterfall_file_record) +
+                         (uint64_t)nchannels * vec_points * sample_size(storage);
+  return (uint32_t)((bytes + WATERFALL_FILE_ALIGN - 1) / WATERFALL_FILE_ALIGN *
+                    WATERFALL_FILE_ALIGN);
+}
+
+waterfall_file_writer::waterfall_file_writer()
+    : d_fp(NULL), d_rows(0), d_dropped(0), d_closing(false), d_failed(false)
+{
+  memset(&d_header, 0, sizeof(d_header));
+}
+
+waterfall_file_writer::~waterfall_file_writer() { close(); }
+
+bool waterfall_file_writer::open(const std::string &filename,
+                                 unsigned int nchannels,
+                                 unsigned int vec_points,
+                                 storage_type_t storage,
+                                 double storage_offset,
+                                 double storage_scale)
+{
+  close();
+
+  if ((nchannels == 0) || (vec_points == 0))
+    return false;
+
+  d_fp = fopen(filename.c_str(), "wb");
+  if (d_fp == NULL)
+    return false;
+
+  memset(&d_header, 0, sizeof(d_header));
+  memcpy(d_header.magic, WATERFALL_FILE_MAGIC, sizeof(d_header.magic));
+  d_header.version = WATERFALL_FILE_VERSION;
+  d_header.header_size = sizeof(waterfall_file_header);
+  d_header.record_size = record_size(nchannels, vec_points, storage);
+  d_header.nchannels = nchannels;
+  d_header.vec_points = vec_points;
+  d_header.storage_type = storage;
+  d_header.storage_offset = storage_offset;
+  d_header.storage_scale = storage_codec(storage, storage_offset, storage_scale).scale();
+  d_header.timestamp_tps = (double)gr::high_res_timer_tps();
+  d_header.timestamp_epoch = gr::high_res_timer_epoch();
+
+  d_record.assign(d_header.record_size, 0);
+
+  if (fwrite(&d_header, sizeof(d_header), 1, d_fp) != 1)
+  {
+    fclose(d_fp);
+    d_fp = NULL;
+    return false;
+  }
+
+  d_pending.clear();
+  d_spare.clear();
+  d_rows = 0;
+  d_dropped = 0;
+  d_closing = false;
+  d_failed = false;
+  d_thread = gr::thread::thread(boost::bind(&waterfall_file_writer::run, this));
+  return true;
+}
+
+void waterfall_file_writer::close()
+{
+  if (d_fp == NULL)
+    return;
+
+  {
+    gr::thread::scoped_lock lock(d_mutex);
+    d_closing = true;
+  }
+  d_cond.notify_one();
+  d_thread.join();
+
+  fclose(d_fp);
+  d_fp = NULL;
+}
+
+uint64_t waterfall_file_writer::rows_written() const
+{
+  gr::thread::scoped_lock lock(d_mutex);
+  return d_rows;
+}
+
+uint64_t waterfall_file_writer::rows_dropped() const
+{
+  gr::thread::scoped_lock lock(d_mutex);
+  return d_dropped;
+}
+
+void waterfall_file_writer::begin_row(int64_t timestamp, double center_freq, double bandwidth)
+{
+  waterfall_file_record *rec = (waterfall_file_record *)&d_record[0];
+  rec->timestamp = timestamp;
+  rec->center_freq = center_freq;
+  rec->bandwidth = bandwidth;
+  rec->flags = 0;
+  rec->reserved = 0;
+}
+
+void waterfall_file_writer::write_channel(unsigned int channel, const float *row)
+{
+  if (channel >= d_header.nchannels)
+    return;
+
+  const uint32_t npoints = d_header.vec_points;
+  uint8_t *dst = &d_record[sizeof(waterfall_file_record) +
+                           (size_t)channel * npoints * sample_size(d_header.storage_type)];
+
+  // Same encoding as WaterfallVectorData, so a reloaded row matches the display
+  storage_codec(d_header.storage_type, d_header.storage_offset, d_header.storage_scale)
+      .encode(dst, row, npoints);
+}
+
+bool waterfall_file_writer::end_row()
+{
+  if (d_fp == NULL)
+    return false;
+
+  {
+    gr::thread::scoped_lock lock(d_mutex);
+    if (d_failed)
+      return false;
+    if (d_pending.size() >= MAX_PENDING_ROWS)
+    {
+      d_dropped++;
+      return false;
+    }
+
+    // The assembled record is queued as is; a spare buffer of the same
+    // size takes its place for the next row
+    d_pending.push_back(std::vector<uint8_t>());
+    d_pending.back().swap(d_record);
+    if (d_spare.empty())
+    {
+      d_record.assign(d_header.record_size, 0);
+    }
+    else
+    {
+      d_record.swap(d_spare.back());
+      d_spare.pop_back();
+    }
+  }
+  d_cond.notify_one();
+  return true;
+}
+
+void waterfall_file_writer::run()
+{
+  gr::thread::scoped_lock lock(d_mutex);
+  while (true)
+  {
+    while (d_pending.empty() && !d_closing)
+      d_cond.wait(lock);
+    if (d_pending.empty())
+      break;
+
+    std::vector<uint8_t> record;
+    record.swap(d_pending.front());
+    d_pending.pop_front();
+
+    lock.unlock();
+    const bool ok = !d_failed && (fwrite(&record[0], record.size(), 1, d_fp) == 1);
+    lock.lock();
+
+    if (ok)
+      d_rows++;
+    else
+      d_failed = true;
+    d_spare.push_back(std::vector<uint8_t>());
+    d_spare.back().swap(record);
+  }
+}
+
+waterfall_file_reader::waterfall_file_reader()
+    : d_base(NULL), d_length(0), d_header(NULL), d_rows(0)
+{
+}
+
+waterfall_file_reader::~waterfall_file_reader() { close(); }
+
+bool waterfall_file_reader::open(const std::string &filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(waterfall_file_header)))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED)
+    return false;
+
+  d_base = (uint8_t *)base;
+  d_length = st.st_size;
+  d_header = (const waterfall_file_header *)d_base;
+
+  if ((memcmp(d_header->magic, WATERFALL_FILE_MAGIC, sizeof(d_header->magic)) != 0) ||
+      (d_header->version != WATERFALL_FILE_VERSION) ||
+      (d_header->header_size < sizeof(waterfall_file_header)) ||
+      (d_header->header_size > d_length) ||
+      (d_header->record_size != record_size(d_header->nchannels, d_header->vec_points,
+                                            d_header->storage_type)))
+  {
+    close();
+    return false;
+  }
+
+  // A trailing partial record (e.g. from a crash) is ignored
+  d_rows = (d_length - d_header->header_size) / d_header->record_size;
+  return true;
+}
+
+void waterfall_file_reader::close()
+{
+  if (d_base != NULL)
+  {
+    munmap(d_base, d_length);
+    d_base = NULL;
+  }
+  d_length = 0;
+  d_header = NULL;
+  d_rows = 0;
+}
+
+const waterfall_file_record *waterfall_file_reader::record(uint64_t row) const
+{
+  if (row >= d_rows)
+    return NULL;
+  return (const waterfall_file_record *)(d_base + d_header->header_size +
+                                         row * d_header->record_size);
+}
+
+const void *waterfall_file_reader::data(uint64_t row, unsigned int channel) const
+{
+  const waterfall_file_record *rec = record(row);
+  if ((rec == NULL) || (channel >= d_header->nchannels))
+    return NULL;
+  return (const uint8_t *)(rec + 1) +
+         (size_t)channel * d_header->vec_points * sample_size(d_header->storage_type);
+}
+
+bool waterfall_file_reader::read_row(uint64_t row, unsigned int channel, float *out) const
+{
+  const void *src = data(row, channel);
+  if (src == NULL)
+    return false;
+
+  storage_codec(d_header->storage_type, d_header->storage_offset, d_header->storage_scale)
+      .decode(out, src, d_header->vec_points);
+  return true;
+}
+
+} // namespace spectrogram
+} // namespace gr
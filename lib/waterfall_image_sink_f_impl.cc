@@ -0,0 +1,272 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "waterfall_image_sink_f_impl.h"
+#include <gnuradio/io_signature.h>
+#include <algorithm>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+waterfall_image_sink_f::sptr waterfall_image_sink_f::make(int vecsize,
+                                                          double freqcenter,
+                                                          double bandwidth,
+                                                          int nconnections,
+                                                          int width,
+                                                          int nrows,
+                                                          storage_type_t storage,
+                                                          double storage_offset,
+                                                          double storage_scale)
+{
+  return gnuradio::get_initial_sptr(
+      new waterfall_image_sink_f_impl(vecsize, freqcenter, bandwidth, nconnections, width,
+                                      nrows, storage, storage_offset, storage_scale));
+}
+
+waterfall_image_sink_f_impl::waterfall_image_sink_f_impl(int vecsize,
+                                                         double freqcenter,
+                                                         double bandwidth,
+                                                         int nconnections,
+                                                         int width,
+                                                         int nrows,
+                                                         storage_type_t storage,
+                                                         double storage_offset,
+                                                         double storage_scale)
+    : gr::sync_block("waterfall_image_sink_f",
+                     io_signature::make(0, nconnections, sizeof(float) * vecsize),
+                     io_signature::make(0, 0, 0)),
+      d_vecsize(vecsize), d_width((width > 0) ? width : vecsize),
+      d_nrows(std::max(nrows, 1)), d_vecavg(1.0), d_avg_mode(AVERAGE_EXPONENTIAL),
+      d_hold_reset(true), d_integration(0),
+      d_center_freq(freqcenter), d_bandwidth(bandwidth), d_nconnections(nconnections),
+      d_storage(storage), d_storage_offset(storage_offset), d_storage_scale(storage_scale),
+      d_rows(vecsize, nconnections)
+{
+  for (int i = 0; i < d_nconnections; i++)
+  {
+    d_data.push_back(new WaterfallVectorData(d_center_freq - d_bandwidth / 2.0,
+                                             d_center_freq + d_bandwidth / 2.0,
+                                             d_vecsize, d_nrows,
+                                             storage, storage_offset, storage_scale));
+    d_renderers.push_back(new waterfall_renderer());
+  }
+
+  set_update_time(0.1);
+}
+
+waterfall_image_sink_f_impl::~waterfall_image_sink_f_impl()
+{
+  for (int i = 0; i < d_nconnections; i++)
+  {
+    delete d_data[i];
+    delete d_renderers[i];
+  }
+}
+
+bool waterfall_image_sink_f_impl::check_topology(int ninputs, int noutputs)
+{
+  return ninputs == d_nconnections;
+}
+
+void waterfall_image_sink_f_impl::clear_data()
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_hold_reset = true;
+  for (int i = 0; i < d_nconnections; i++)
+    d_data[i]->reset();
+}
+
+int waterfall_image_sink_f_impl::vec_size() const { return d_vecsize; }
+
+int waterfall_image_sink_f_impl::width() const { return d_width; }
+
+int waterfall_image_sink_f_impl::nrows() const { return d_nrows; }
+
+void waterfall_image_sink_f_impl::set_vec_average(const float vecavg)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_vecavg = vecavg;
+}
+
+float waterfall_image_sink_f_impl::vec_average() const { return d_vecavg; }
+
+void waterfall_image_sink_f_impl::set_average_mode(const average_mode_t mode)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_avg_mode = mode;
+  d_hold_reset = true;
+}
+
+average_mode_t waterfall_image_sink_f_impl::average_mode() const { return d_avg_mode; }
+
+void waterfall_image_sink_f_impl::set_integration(const int count)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_integration = std::max(count, 0);
+  d_hold_reset = true;
+}
+
+int waterfall_image_sink_f_impl::integration() const { return d_integration; }
+
+void waterfall_image_sink_f_impl::set_update_time(double t)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_update_time = t * gr::high_res_timer_tps();
+}
+
+void waterfall_image_sink_f_impl::set_frequency_range(const double centerfreq,
+                                                      const double bandwidth)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_center_freq = centerfreq;
+  d_bandwidth = bandwidth;
+  for (int i = 0; i < d_nconnections; i++)
+    d_data[i]->resizeData(d_center_freq - d_bandwidth / 2.0,
+                          d_center_freq + d_bandwidth / 2.0,
+                          d_vecsize);
+}
+
+double waterfall_image_sink_f_impl::center_freq() const { return d_center_freq; }
+
+double waterfall_image_sink_f_impl::bandwidth() const { return d_bandwidth; }
+
+void waterfall_image_sink_f_impl::set_intensity_range(const double min, const double max)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  for (int i = 0; i < d_nconnections; i++)
+    d_renderers[i]->set_intensity_range(min, max);
+}
+
+void waterfall_image_sink_f_impl::set_color_map(int which, const int color)
+{
+  if ((which < 0) || (which >= d_nconnections))
+    return;
+  gr::thread::scoped_lock lock(d_setlock);
+  d_renderers[which]->set_color_map(color);
+}
+
+int waterfall_image_sink_f_impl::color_map(int which)
+{
+  if ((which < 0) || (which >= d_nconnections))
+    return 0;
+  return d_renderers[which]->color_map();
+}
+
+QImage waterfall_image_sink_f_impl::image(int which)
+{
+  QImage img(d_width, d_nrows, QImage::Format_ARGB32);
+  img.fill(0);
+  if ((which < 0) || (which >= d_nconnections))
+    return img;
+
+  gr::thread::scoped_lock lock(d_setlock);
+  d_renderers[which]->render(img, *d_data[which]);
+  return img;
+}
+
+std::vector<uint8_t> waterfall_image_sink_f_impl::rgba(int which)
+{
+  const QImage img = image(which);
+
+  std::vector<uint8_t> out(4 * d_width * d_nrows);
+  uint8_t *p = out.empty() ? NULL : &out[0];
+  for (int y = 0; y < d_nrows; y++)
+  {
+    const QRgb *line = (const QRgb *)img.constScanLine(y);
+    for (int x = 0; x < d_width; x++)
+    {
+      *p++ = qRed(line[x]);
+      *p++ = qGreen(line[x]);
+      *p++ = qBlue(line[x]);
+      *p++ = qAlpha(line[x]);
+    }
+  }
+  return out;
+}
+
+bool waterfall_image_sink_f_impl::start_recording(const std::string &filename)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  return d_recorder.open(
+      filename, d_nconnections, d_vecsize, d_storage, d_storage_offset, d_storage_scale);
+}
+
+void waterfall_image_sink_f_impl::stop_recording()
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_recorder.close();
+}
+
+bool waterfall_image_sink_f_impl::recording() const { return d_recorder.is_open(); }
+
+bool waterfall_image_sink_f_impl::save_image(int which, const std::string &filename)
+{
+  return image(which).save(QString::fromStdString(filename));
+}
+
+void waterfall_image_sink_f_impl::emit_row()
+{
+  const std::vector<float *> &rows = d_rows.rows();
+
+  gr::thread::scoped_lock lock(d_setlock);
+  for (int n = 0; n < d_nconnections; n++)
+    d_data[n]->addVecData(rows[n], d_vecsize, 0);
+
+  if (d_recorder.is_open())
+  {
+    d_recorder.begin_row(d_rows.last_time(), d_center_freq, d_bandwidth);
+    for (int n = 0; n < d_nconnections; n++)
+      d_recorder.write_channel(n, rows[n]);
+    d_recorder.end_row();
+  }
+}
+
+int waterfall_image_sink_f_impl::work(int noutput_items,
+                                      gr_vector_const_void_star &input_items,
+                                      gr_vector_void_star &output_items)
+{
+  average_mode_t mode;
+  int count;
+  bool reset;
+  float vecavg;
+  gr::high_res_timer_type update_time;
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    mode = d_avg_mode;
+    count = d_integration;
+    reset = d_hold_reset;
+    d_hold_reset = false;
+    vecavg = d_vecavg;
+    update_time = d_update_time;
+  }
+
+  d_rows.process(input_items, noutput_items, mode, count, vecavg, reset, update_time, *this);
+  return noutput_items;
+}
+
+} // namespace spectrogram
+} // namespace gr
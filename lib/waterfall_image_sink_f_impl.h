@@ -0,0 +1,119 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_IMPL_H
+#define INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_IMPL_H
+
+#include <spectrogram/waterfall_image_sink_f.h>
+#include <spectrogram/WaterfallVectorGlobalData.h>
+#include <spectrogram/waterfall_file.h>
+#include <gnuradio/high_res_timer.h>
+#include "row_averager.h"
+#include "waterfall_renderer.h"
+
+namespace gr
+{
+namespace spectrogram
+{
+
+class SPECTROGRAM_API waterfall_image_sink_f_impl : public waterfall_image_sink_f,
+                                                    private row_averager::handler
+{
+private:
+  int d_vecsize;
+  int d_width;
+  int d_nrows;
+  // Setters write the averaging settings under d_setlock; work() takes a
+  // copy of them under it once per call
+  float d_vecavg;
+  average_mode_t d_avg_mode;
+  bool d_hold_reset;
+  int d_integration;
+  double d_center_freq;
+  double d_bandwidth;
+  int d_nconnections;
+  storage_type_t d_storage;
+  double d_storage_offset;
+  double d_storage_scale;
+
+  row_averager d_rows;
+
+  // History and renderer per connection, guarded by d_setlock
+  std::vector<WaterfallVectorData *> d_data;
+  std::vector<waterfall_renderer *> d_renderers;
+  waterfall_file_writer d_recorder;
+
+  gr::high_res_timer_type d_update_time;
+
+  void emit_row();
+
+public:
+  waterfall_image_sink_f_impl(int vecsize,
+                              double freqcenter, double bandwidth,
+                              int nconnections,
+                              int width,
+                              int nrows,
+                              storage_type_t storage,
+                              double storage_offset,
+                              double storage_scale);
+  ~waterfall_image_sink_f_impl();
+
+  bool check_topology(int ninputs, int noutputs);
+
+  void clear_data();
+
+  int vec_size() const;
+  int width() const;
+  int nrows() const;
+
+  void set_vec_average(const float vecavg);
+  float vec_average() const;
+  void set_average_mode(const average_mode_t mode);
+  average_mode_t average_mode() const;
+  void set_integration(const int count);
+  int integration() const;
+  void set_update_time(double t);
+
+  void set_frequency_range(const double centerfreq, const double bandwidth);
+  double center_freq() const;
+  double bandwidth() const;
+
+  void set_intensity_range(const double min, const double max);
+  void set_color_map(int which, const int color);
+  int color_map(int which);
+
+  QImage image(int which);
+  std::vector<uint8_t> rgba(int which);
+  bool save_image(int which, const std::string &filename);
+
+  bool start_recording(const std::string &filename);
+  void stop_recording();
+  bool recording() const;
+
+  int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_WATERFALL_IMAGE_SINK_F_IMPL_H */
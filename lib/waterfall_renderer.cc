@@ -0,0 +1,122 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "waterfall_renderer.h"
+#include <spectrogram/spectrogram_types.h>
+#include <qwt_color_map.h>
+
+namespace gr
+{
+namespace spectrogram
+{
+
+static QwtColorMap *make_color_map(int type, const QColor &low, const QColor &high)
+{
+  switch (type)
+  {
+  case INTENSITY_COLOR_MAP_TYPE_WHITE_HOT:
+    return new ColorMap_WhiteHot();
+  case INTENSITY_COLOR_MAP_TYPE_BLACK_HOT:
+    return new ColorMap_BlackHot();
+  case INTENSITY_COLOR_MAP_TYPE_INCANDESCENT:
+    return new ColorMap_Incandescent();
+  case INTENSITY_COLOR_MAP_TYPE_SUNSET:
+    return new ColorMap_Sunset();
+  case INTENSITY_COLOR_MAP_TYPE_COOL:
+    return new ColorMap_Cool();
+  case INTENSITY_COLOR_MAP_TYPE_USER_DEFINED:
+    return new ColorMap_UserDefined(low, high);
+  case INTENSITY_COLOR_MAP_TYPE_MULTI_COLOR:
+  default:
+    return new ColorMap_MultiColor();
+  }
+}
+
+waterfall_renderer::waterfall_renderer()
+    : d_color_map_type(INTENSITY_COLOR_MAP_TYPE_MULTI_COLOR),
+      d_color_map(new ColorMap_MultiColor()), d_min(-120), d_max(10), d_reducer_len(0)
+{
+}
+
+waterfall_renderer::~waterfall_renderer() { delete d_color_map; }
+
+void waterfall_renderer::set_color_map(int type, const QColor &low, const QColor &high)
+{
+  delete d_color_map;
+  d_color_map = make_color_map(type, low, high);
+  d_color_map_type = type;
+  d_lut.invalidate();
+}
+
+void waterfall_renderer::set_intensity_range(double min, double max)
+{
+  d_min = min;
+  d_max = max;
+}
+
+void waterfall_renderer::render(QImage &image, const WaterfallVectorData &data)
+{
+  const uint64_t vlen = data.getNumVecPoints();
+  const uint64_t nrows = data.getNumRows();
+  const int width = image.width();
+  const int height = image.height();
+  if ((vlen == 0) || (nrows == 0) || (width <= 0) || (height <= 0))
+    return;
+
+  if (!d_reducer || (d_reducer_len != vlen))
+  {
+    d_reducer.reset(new bin_reducer(vlen));
+    d_reducer->set_mode(BIN_REDUCE_MAX);
+    d_reducer_len = vlen;
+  }
+  d_reducer->configure(width, 0.0, 1.0);
+
+  const unsigned int ncols = d_reducer->out_len();
+  d_row.resize(vlen);
+  d_cols.resize(ncols);
+  d_pixels.resize(width);
+  d_lut.update(*d_color_map, d_min, d_max);
+
+  for (int y = 0; y < height; y++)
+  {
+    // Newest row at the top, as on the plot
+    const uint64_t row = nrows - 1 - ((uint64_t)y * nrows) / height;
+    data.getRow(row, &d_row[0]);
+    d_reducer->reduce(&d_cols[0], &d_row[0]);
+
+    // Stretch the columns to the image width, then colour the row at once
+    const float *pixels = &d_cols[0];
+    if ((int)ncols != width)
+    {
+      for (int x = 0; x < width; x++)
+        d_pixels[x] = d_cols[((uint64_t)x * ncols) / width];
+      pixels = &d_pixels[0];
+    }
+    d_lut.map((QRgb *)image.scanLine(y), pixels, width);
+  }
+}
+
+} // namespace spectrogram
+} // namespace gr
@@ -0,0 +1,85 @@
+/* -*- c++ -*- */
+/* 
+ * Copyright 2019 viteo.
+ * 
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3, or (at your option)
+ * any later version.
+ * 
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this software; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 51 Franklin Street,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef INCLUDED_SPECTROGRAM_WATERFALL_RENDERER_H
+#define INCLUDED_SPECTROGRAM_WATERFALL_RENDERER_H
+
+#include <spectrogram/api.h>
+#include <spectrogram/WaterfallVectorGlobalData.h>
+#include "bin_reducer.h"
+#include "color_lut.h"
+#include <boost/scoped_ptr.hpp>
+#include <QColor>
+#include <QImage>
+#include <vector>
+
+class QwtColorMap;
+
+namespace gr
+{
+namespace spectrogram
+{
+
+/*!
+ * \brief Renders a waterfall history into an image without any widget.
+ *
+ * \details
+ * Uses the same colour maps as WaterfallVectorDisplayPlot (selected by
+ * the INTENSITY_COLOR_MAP_TYPE_* values). The newest row is drawn at the
+ * top; when the image is narrower than the vector each pixel shows the
+ * maximum of the bins it covers, so narrow carriers are not lost.
+ */
+class SPECTROGRAM_API waterfall_renderer
+{
+public:
+  waterfall_renderer();
+  ~waterfall_renderer();
+
+  void set_color_map(int type,
+                     const QColor &low = Qt::white,
+                     const QColor &high = Qt::black);
+  int color_map() const { return d_color_map_type; }
+
+  void set_intensity_range(double min, double max);
+  double min_intensity() const { return d_min; }
+  double max_intensity() const { return d_max; }
+
+  //! Fills \p image (ARGB32, already sized) from the rows of \p data
+  void render(QImage &image, const WaterfallVectorData &data);
+
+private:
+  int d_color_map_type;
+  QwtColorMap *d_color_map;
+  double d_min;
+  double d_max;
+  color_lut d_lut;
+
+  boost::scoped_ptr<bin_reducer> d_reducer;
+  uint64_t d_reducer_len;
+  std::vector<float> d_row;
+  std::vector<float> d_cols;
+  std::vector<float> d_pixels;
+};
+
+} // namespace spectrogram
+} // namespace gr
+
+#endif /* INCLUDED_SPECTROGRAM_WATERFALL_RENDERER_H */
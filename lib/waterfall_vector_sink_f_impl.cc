@@ -26,21 +26,31 @@
 #include <gnuradio/io_signature.h>
 #include <gnuradio/prefs.h>
 #include <volk/volk.h>
+#include <algorithm>
 
 namespace gr
 {
 namespace spectrogram
 {
 
+// Number of rows that can be in flight between work() and the GUI
+static const unsigned int ROW_POOL_SLOTS = 16;
+
 waterfall_vector_sink_f::sptr waterfall_vector_sink_f::make(int vecsize,
                                                             double freqcenter,
                                                             double bandwidth,
                                                             const std::string &name,
                                                             int nconnections,
-                                                            QWidget *parent)
+                                                            QWidget *parent,
+                                                            storage_type_t storage,
+                                                            double storage_offset,
+                                                            double storage_scale,
+                                                            int nrows)
 {
   return gnuradio::get_initial_sptr(
-      new waterfall_vector_sink_f_impl(vecsize, freqcenter, bandwidth, name, nconnections, parent));
+      new waterfall_vector_sink_f_impl(vecsize, freqcenter, bandwidth, name, nconnections,
+                                       parent, storage, storage_offset, storage_scale,
+                                       nrows));
 }
 
 /*
@@ -51,13 +61,25 @@ waterfall_vector_sink_f_impl::waterfall_vector_sink_f_impl(int vecsize,
                                                            double bandwidth,
                                                            const std::string &name,
                                                            int nconnections,
-                                                           QWidget *parent)
+                                                           QWidget *parent,
+                                                           storage_type_t storage,
+                                                           double storage_offset,
+                                                           double storage_scale,
+                                                           int nrows)
     : gr::sync_block("waterfall_vector_sink_f",
                      io_signature::make(0, nconnections, sizeof(float) * vecsize),
                      io_signature::make(0, 0, 0)),
-      d_vecsize(vecsize), d_vecavg(1.0),
-      d_center_freq(freqcenter), d_bandwidth(bandwidth), d_name(name), d_nconnections(nconnections), d_nrows(200),
-      d_parent(parent), d_port(pmt::mp("freq"))
+      d_vecsize(vecsize), d_vecavg(1.0), d_gui_vecavg(1.0), d_avg_mode(AVERAGE_EXPONENTIAL),
+      d_hold_reset(true),
+      d_integration(0), d_vec_rate(0),
+      d_center_freq(freqcenter), d_bandwidth(bandwidth), d_name(name), d_nconnections(nconnections),
+      d_nrows(std::max(nrows, 1)),
+      d_storage(storage), d_storage_offset(storage_offset), d_storage_scale(storage_scale),
+      d_rows(vecsize, nconnections), d_reducer(vecsize), d_row_stats(nconnections),
+      d_display_bins(0),
+      d_bin_reduce(BIN_REDUCE_NONE), d_zoom_aggregation(BIN_REDUCE_NONE),
+      d_history_tiers(0), d_parent(parent), d_port(pmt::mp("freq")),
+      d_fold_time(0), d_fold_start(0)
 {
   // Required now for Qt; argc must be greater than 0 and argv
   // must have at least one valid character. Must be valid through
@@ -70,12 +92,10 @@ waterfall_vector_sink_f_impl::waterfall_vector_sink_f_impl(int vecsize,
   d_main_gui = NULL;
 
   d_index = 0;
-  // save the last "connection" for the PDU memory
-  for (int i = 0; i < d_nconnections; i++)
-  {
-    d_magbufs.push_back((double *)volk_malloc(d_vecsize * sizeof(double), volk_get_alignment()));
-    memset(d_magbufs[i], 0, d_vecsize * sizeof(double));
-  }
+
+  d_row_pool = WaterfallRowPool::sptr(
+      new WaterfallRowPool(ROW_POOL_SLOTS, d_nconnections, d_vecsize));
+  d_metrics = WaterfallMetrics::sptr(new WaterfallMetrics());
 
   initialize();
 }
@@ -88,11 +108,6 @@ waterfall_vector_sink_f_impl::~waterfall_vector_sink_f_impl()
   if (!d_main_gui->isClosed())
     d_main_gui->close();
 
-  for (int i = 0; i < d_nconnections; i++)
-  {
-    volk_free(d_magbufs[i]);
-  }
-
   delete d_argv;
 }
 
@@ -121,6 +136,9 @@ void waterfall_vector_sink_f_impl::initialize()
 
   int numplots = (d_nconnections > 0) ? d_nconnections : 1;
   d_main_gui = new WaterfallVectorDisplayForm(numplots, d_parent);
+  d_main_gui->setStorageType(d_storage, d_storage_offset, d_storage_scale);
+  d_main_gui->setNumRows(d_nrows);
+  d_main_gui->setMetrics(d_metrics);
   set_vec_size(d_vecsize);
   set_frequency_range(d_center_freq, d_bandwidth);
 
@@ -151,15 +169,142 @@ void *waterfall_vector_sink_f_impl::pyqwidget()
 
 void waterfall_vector_sink_f_impl::clear_data()
 {
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    d_hold_reset = true;
+  }
   d_main_gui->clearData();
 }
 
+void waterfall_vector_sink_f_impl::set_average_mode(const average_mode_t mode)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_avg_mode = mode;
+  d_hold_reset = true;
+}
+
+average_mode_t waterfall_vector_sink_f_impl::average_mode() const { return d_avg_mode; }
+
+void waterfall_vector_sink_f_impl::set_integration(const int count, const double vec_rate)
+{
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    d_integration = std::max(count, 0);
+    d_vec_rate = vec_rate;
+    d_hold_reset = true;
+  }
+
+  // The time axis is exact when the input vector rate is known
+  if ((count > 0) && (vec_rate > 0))
+    d_main_gui->setTimePerVec(count / vec_rate);
+}
+
+void waterfall_vector_sink_f_impl::set_rows_per_second(const double rows_per_sec,
+                                                        const double vec_rate)
+{
+  int count = 0;
+  if ((rows_per_sec > 0) && (vec_rate > 0))
+    count = std::max(1, (int)(vec_rate / rows_per_sec + 0.5));
+  set_integration(count, vec_rate);
+}
+
+int waterfall_vector_sink_f_impl::integration() const { return d_integration; }
+
+void waterfall_vector_sink_f_impl::set_display_bins(const int bins, const bin_reduce_t mode)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_display_bins = std::max(bins, 0);
+  d_bin_reduce = (d_display_bins > 0) ? mode : BIN_REDUCE_NONE;
+}
+
+int waterfall_vector_sink_f_impl::display_bins() const { return d_display_bins; }
+
+void waterfall_vector_sink_f_impl::set_zoom_aggregation(const bin_reduce_t mode)
+{
+  d_zoom_aggregation = mode;
+  d_main_gui->setAggregation(mode);
+}
+
+bin_reduce_t waterfall_vector_sink_f_impl::zoom_aggregation() const
+{
+  return d_zoom_aggregation;
+}
+
+void waterfall_vector_sink_f_impl::set_history_tiers(const int tiers,
+                                                     const int decimation,
+                                                     const bin_reduce_t mode)
+{
+  d_history_tiers = std::max(tiers, 0);
+  d_main_gui->setHistoryTiers(d_history_tiers, decimation, mode);
+}
+
+int waterfall_vector_sink_f_impl::history_tiers() const { return d_history_tiers; }
+
+void waterfall_vector_sink_f_impl::set_nrows(const int nrows)
+{
+  d_nrows = std::max(nrows, 1);
+  d_main_gui->setNumRows(d_nrows);
+}
+
+int waterfall_vector_sink_f_impl::nrows() const { return d_nrows; }
+
+uint64_t waterfall_vector_sink_f_impl::counter(counter_t which) const
+{
+  return d_metrics->counter(which);
+}
+
+uint64_t waterfall_vector_sink_f_impl::queue_depth() const { return d_metrics->queueDepth(); }
+
+double waterfall_vector_sink_f_impl::latency(latency_t which, double percentile) const
+{
+  return d_metrics->percentile(which, percentile);
+}
+
+double waterfall_vector_sink_f_impl::mean_latency(latency_t which) const
+{
+  return d_metrics->mean(which);
+}
+
+void waterfall_vector_sink_f_impl::reset_metrics() { d_metrics->reset(); }
+
+void waterfall_vector_sink_f_impl::enable_metrics_overlay(bool en)
+{
+  d_main_gui->setMetricsOverlay(en);
+}
+
+uint64_t waterfall_vector_sink_f_impl::history_bytes() const
+{
+  return d_main_gui->getHistoryMemory();
+}
+
+storage_type_t waterfall_vector_sink_f_impl::storage_type() const { return d_storage; }
+
+bool waterfall_vector_sink_f_impl::start_recording(const std::string &filename)
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  return d_recorder.open(
+      filename, d_nconnections, d_vecsize, d_storage, d_storage_offset, d_storage_scale);
+}
+
+void waterfall_vector_sink_f_impl::stop_recording()
+{
+  gr::thread::scoped_lock lock(d_setlock);
+  d_recorder.close();
+}
+
+bool waterfall_vector_sink_f_impl::recording() const { return d_recorder.is_open(); }
+
 void waterfall_vector_sink_f_impl::set_vec_size(const int vecsize) { d_main_gui->setVecSize(vecsize); }
 
 int waterfall_vector_sink_f_impl::vec_size() const { return d_vecsize; }
 
 void waterfall_vector_sink_f_impl::set_vec_average(const float vecavg)
 {
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    d_vecavg = vecavg;
+    d_gui_vecavg = vecavg;
+  }
   d_main_gui->setVecAverage(vecavg);
 }
 
@@ -181,11 +326,17 @@ void waterfall_vector_sink_f_impl::set_update_time(double t)
 {
   // convert update time to ticks
   gr::high_res_timer_type tps = gr::high_res_timer_tps();
-  d_update_time = t * tps;
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    d_update_time = t * tps;
+  }
   d_main_gui->setUpdateTime(t);
-  d_last_time = 0;
 }
 
+void waterfall_vector_sink_f_impl::set_max_fps(double fps) { d_main_gui->setMaxFrameRate(fps); }
+
+double waterfall_vector_sink_f_impl::max_fps() { return d_main_gui->getMaxFrameRate(); }
+
 void waterfall_vector_sink_f_impl::set_title(const std::string &title)
 {
   d_main_gui->setTitle(title.c_str());
@@ -230,7 +381,34 @@ double waterfall_vector_sink_f_impl::line_alpha(int which)
   return (double)(d_main_gui->getAlpha(which)) / 255.0;
 }
 
-void waterfall_vector_sink_f_impl::auto_scale() { d_main_gui->autoScale(); }
+void waterfall_vector_sink_f_impl::set_composite_mode(const composite_mode_t mode)
+{
+  d_main_gui->setCompositeMode(mode);
+}
+
+composite_mode_t waterfall_vector_sink_f_impl::composite_mode()
+{
+  return (composite_mode_t)d_main_gui->getCompositeMode();
+}
+
+void waterfall_vector_sink_f_impl::set_tile_layout(const tile_layout_t layout)
+{
+  d_main_gui->setTileLayout(layout);
+}
+
+tile_layout_t waterfall_vector_sink_f_impl::tile_layout()
+{
+  return (tile_layout_t)d_main_gui->getTileLayout();
+}
+
+void waterfall_vector_sink_f_impl::auto_scale()
+{
+  d_main_gui->autoScale(d_main_gui->getAutoLevel());
+}
+
+void waterfall_vector_sink_f_impl::enable_auto_level(bool en) { d_main_gui->autoScale(en); }
+
+bool waterfall_vector_sink_f_impl::auto_level() const { return d_main_gui->getAutoLevel(); }
 
 double waterfall_vector_sink_f_impl::min_intensity(int which)
 {
@@ -261,34 +439,150 @@ void waterfall_vector_sink_f_impl::check_clicked()
 
 void waterfall_vector_sink_f_impl::set_time_per_vec(double t) { d_main_gui->setTimePerVec(t); }
 
+void waterfall_vector_sink_f_impl::fill_row(float *out, const float *in)
+{
+  if (d_reducer.mode() == BIN_REDUCE_NONE)
+    memcpy(out, in, d_vecsize * sizeof(float));
+  else
+    d_reducer.reduce(out, in);
+}
+
+void waterfall_vector_sink_f_impl::emit_row()
+{
+  // A row's averaging time is the folding done since the previous row,
+  // whatever the size of the work() calls it was spread over
+  d_fold_time += gr::high_res_timer_now() - d_fold_start;
+  d_metrics->record(LATENCY_AVERAGING, double(d_fold_time) / gr::high_res_timer_tps());
+  d_fold_time = 0;
+
+  post_row();
+  d_fold_start = gr::high_res_timer_now();
+}
+
+void waterfall_vector_sink_f_impl::post_row()
+{
+  const std::vector<float *> &magbufs = d_rows.rows();
+
+  {
+    gr::thread::scoped_lock lock(d_setlock);
+    if (d_recorder.is_open())
+    {
+      d_recorder.begin_row(d_rows.last_time(), d_center_freq, d_bandwidth);
+      for (int n = 0; n < d_nconnections; n++)
+        d_recorder.write_channel(n, magbufs[n]);
+      d_recorder.end_row();
+    }
+  }
+
+  // If every row is still in flight the GUI is behind, so the row is
+  // counted as dropped.
+  int slot = d_row_pool->acquire();
+  if (slot < 0)
+  {
+    d_row_pool->markDropped();
+    d_metrics->count(COUNTER_ROWS_DROPPED);
+    return;
+  }
+
+  const std::vector<float *> &rows = d_row_pool->rows(slot);
+  const unsigned int length =
+      (d_reducer.mode() == BIN_REDUCE_NONE) ? d_vecsize : d_reducer.out_len();
+  for (int n = 0; n < d_nconnections; n++)
+  {
+    fill_row(rows[n], magbufs[n]);
+
+    // Autoscaling on the GUI side reads these instead of scanning rows
+    d_row_stats[n].update(rows[n], length);
+    d_row_pool->setRowStats(slot,
+                            n,
+                            d_row_stats[n].noise_floor(),
+                            d_row_stats[n].peak_level());
+  }
+  publish_row(slot);
+}
+
+void waterfall_vector_sink_f_impl::publish_row(int slot)
+{
+  bool notify;
+  if (d_reducer.mode() == BIN_REDUCE_NONE)
+    notify = d_row_pool->publish(slot, d_rows.last_time());
+  else
+    notify = d_row_pool->publish(
+        slot, d_rows.last_time(), d_reducer.out_len(), d_reducer.span_lo(), d_reducer.span_hi());
+
+  d_metrics->count(COUNTER_ROWS_POSTED);
+  if (notify)
+  {
+    d_metrics->count(COUNTER_EVENTS_POSTED);
+    d_qApplication->postEvent(d_main_gui->getRenderWorker(),
+                              new WaterfallUpdateEvent(d_row_pool));
+  }
+  else
+  {
+    d_metrics->count(COUNTER_ROWS_COALESCED);
+  }
+}
+
 int waterfall_vector_sink_f_impl::work(int noutput_items,
                                        gr_vector_const_void_star &input_items,
                                        gr_vector_void_star &output_items)
 {
-  const float *in = (const float *)input_items[0];
+  d_metrics->count(COUNTER_VECTORS_CONSUMED, noutput_items);
 
-  // Update the vec size from the application
   check_clicked();
 
-  for (int i = 0; i < noutput_items; i++)
+  // One consistent copy of the settings for this call
+  average_mode_t mode;
+  int count;
+  bool reset;
+  float vecavg;
+  int display_bins;
+  bin_reduce_t bin_reduce;
+  gr::high_res_timer_type update_time;
   {
-    if (gr::high_res_timer_now() - d_last_time > d_update_time)
+    gr::thread::scoped_lock lock(d_setlock);
+
+    // The average menu only overrides set_vec_average() when it is used
+    const float gui_vecavg = d_main_gui->getVecAverage();
+    if (gui_vecavg != d_gui_vecavg)
     {
-      for (int n = 0; n < d_nconnections; n++)
-      {
-        in = ((const float *)input_items[n]) + d_vecsize;
-        for (int x = 0; x < d_vecsize; x++)
-        {
-          d_magbufs[n][x] =
-              (double)((1.0 - d_vecavg) * d_magbufs[n][x] + (d_vecavg)*in[x]);
-        }
-      }
-
-      d_last_time = gr::high_res_timer_now();
-      d_qApplication->postEvent(
-          d_main_gui, new WaterfallUpdateEvent(d_magbufs, d_vecsize, d_last_time));
+      d_gui_vecavg = gui_vecavg;
+      d_vecavg = gui_vecavg;
     }
+
+    mode = d_avg_mode;
+    count = d_integration;
+    reset = d_hold_reset;
+    d_hold_reset = false;
+    vecavg = d_vecavg;
+    display_bins = d_display_bins;
+    bin_reduce = d_bin_reduce;
+    update_time = d_update_time;
   }
+
+  // Follow zooming so only the visible span is reduced and sent
+  if (d_reducer.mode() != bin_reduce)
+    d_reducer.set_mode(bin_reduce);
+  if (bin_reduce != BIN_REDUCE_NONE)
+  {
+    double span_lo, span_hi;
+    d_main_gui->getVisibleSpan(span_lo, span_hi);
+    d_reducer.configure(display_bins, span_lo, span_hi);
+  }
+
+  if (reset)
+  {
+    for (int n = 0; n < d_nconnections; n++)
+      d_row_stats[n].reset();
+  }
+
+  // Exact integration emits a row per count vectors, the other modes
+  // one per update time; emit_row() records the averaging time per row
+  d_fold_start = gr::high_res_timer_now();
+  d_rows.process(
+      input_items, noutput_items, mode, count, vecavg, reset, update_time, *this);
+  d_fold_time += gr::high_res_timer_now() - d_fold_start;
+
   // Tell runtime system how many output items we produced.
   return noutput_items;
 }
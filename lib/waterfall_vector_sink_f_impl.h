@@ -22,32 +22,58 @@
 #define INCLUDED_SPECTROGRAM_WATERFALL_VECTOR_SINK_F_IMPL_H
 
 #include <spectrogram/waterfall_vector_sink_f.h>
+#include <spectrogram/waterfall_file.h>
 #include <gnuradio/high_res_timer.h>
+#include <spectrogram/WaterfallMetrics.h>
 #include <spectrogram/WaterfallVectorDisplayForm.h>
+#include "bin_reducer.h"
+#include "row_averager.h"
+#include "row_stats.h"
 
 namespace gr
 {
 namespace spectrogram
 {
 
-class SPECTROGRAM_API waterfall_vector_sink_f_impl : public waterfall_vector_sink_f
+class SPECTROGRAM_API waterfall_vector_sink_f_impl : public waterfall_vector_sink_f,
+                                                     private row_averager::handler
 {
 private:
 
   void initialize();
 
   int d_vecsize;
+  // Setters write the averaging and reduction settings under d_setlock;
+  // work() takes a copy of them under it once per call
   float d_vecavg;
+  // Last average read from the GUI menu, so only a change overrides d_vecavg
+  float d_gui_vecavg;
+  average_mode_t d_avg_mode;
+  bool d_hold_reset;
+  int d_integration;
+  double d_vec_rate;
   double d_center_freq;
   double d_bandwidth;
   std::string d_name;
   int d_nconnections;
   int d_nrows;
+  storage_type_t d_storage;
+  double d_storage_offset;
+  double d_storage_scale;
 
   const pmt::pmt_t d_port;
 
   int d_index;
-  std::vector<double *> d_magbufs;
+  row_averager d_rows;
+  bin_reducer d_reducer;
+  std::vector<row_stats> d_row_stats;
+  int d_display_bins;
+  bin_reduce_t d_bin_reduce;
+  bin_reduce_t d_zoom_aggregation;
+  int d_history_tiers;
+  WaterfallRowPool::sptr d_row_pool;
+  WaterfallMetrics::sptr d_metrics;
+  waterfall_file_writer d_recorder;
 
   int d_argc;
   char *d_argv;
@@ -55,17 +81,29 @@ private:
   WaterfallVectorDisplayForm *d_main_gui;
 
   gr::high_res_timer_type d_update_time;
-  gr::high_res_timer_type d_last_time;
+  // Averaging time spent since the last row, and when work() last
+  // resumed folding
+  gr::high_res_timer_type d_fold_time;
+  gr::high_res_timer_type d_fold_start;
 
   // TODO remove this?
   void check_clicked();
 
+  void fill_row(float *out, const float *in);
+  void emit_row();
+  void post_row();
+  void publish_row(int slot);
+
 public:
   waterfall_vector_sink_f_impl(int vecsize,
                                double freqcenter, double bandwidth,
                                const std::string &name,
                                int nconnections,
-                               QWidget *parent = NULL);
+                               QWidget *parent = NULL,
+                               storage_type_t storage = STORAGE_FLOAT,
+                               double storage_offset = -150.0,
+                               double storage_scale = 0.0,
+                               int nrows = 200);
   ~waterfall_vector_sink_f_impl();
 
   bool check_topology(int ninputs, int noutputs);
@@ -81,15 +119,44 @@ public:
 
   void clear_data();
 
+  storage_type_t storage_type() const;
+
+  bool start_recording(const std::string &filename);
+  void stop_recording();
+  bool recording() const;
+
   void set_vec_size(const int fftsize);
   int vec_size() const;
   void set_vec_average(const float fftavg);
   float vec_average() const;
+  void set_average_mode(const average_mode_t mode);
+  average_mode_t average_mode() const;
+  void set_integration(const int count, const double vec_rate = 0);
+  void set_rows_per_second(const double rows_per_sec, const double vec_rate);
+  int integration() const;
+  void set_display_bins(const int bins, const bin_reduce_t mode);
+  int display_bins() const;
+  void set_zoom_aggregation(const bin_reduce_t mode);
+  bin_reduce_t zoom_aggregation() const;
+  void set_history_tiers(const int tiers, const int decimation, const bin_reduce_t mode);
+  int history_tiers() const;
+  void set_nrows(const int nrows);
+  int nrows() const;
+  uint64_t history_bytes() const;
+
+  uint64_t counter(counter_t which) const;
+  uint64_t queue_depth() const;
+  double latency(latency_t which, double percentile) const;
+  double mean_latency(latency_t which) const;
+  void reset_metrics();
+  void enable_metrics_overlay(bool en);
 
   void set_frequency_range(const double centerfreq, const double bandwidth);
   void set_intensity_range(const double min, const double max);
 
   void set_update_time(double t);
+  void set_max_fps(double fps);
+  double max_fps();
   void set_time_per_vec(double t);
   void set_title(const std::string &title);
   void set_time_title(const std::string &title);
@@ -102,9 +169,17 @@ public:
   double line_alpha(int which);
   int color_map(int which);
 
+  void set_composite_mode(const composite_mode_t mode);
+  composite_mode_t composite_mode();
+
+  void set_tile_layout(const tile_layout_t layout);
+  tile_layout_t tile_layout();
+
   void set_size(int width, int height);
 
   void auto_scale();
+  void enable_auto_level(bool en);
+  bool auto_level() const;
   double min_intensity(int which);
   double max_intensity(int which);
 
@@ -8,9 +8,25 @@
 %include "spectrogram_swig_doc.i"
 
 %{
+#include "spectrogram/average_mode.h"
+#include "spectrogram/bin_reduce.h"
+#include "spectrogram/composite_mode.h"
+#include "spectrogram/metric_type.h"
+#include "spectrogram/storage_type.h"
+#include "spectrogram/tile_layout.h"
 #include "spectrogram/waterfall_vector_sink_f.h"
+#include "spectrogram/waterfall_image_sink_f.h"
 %}
 
 
+%include "spectrogram/average_mode.h"
+%include "spectrogram/bin_reduce.h"
+%include "spectrogram/composite_mode.h"
+%include "spectrogram/metric_type.h"
+%include "spectrogram/storage_type.h"
+%include "spectrogram/tile_layout.h"
 %include "spectrogram/waterfall_vector_sink_f.h"
 GR_SWIG_BLOCK_MAGIC2(spectrogram, waterfall_vector_sink_f);
+
+%include "spectrogram/waterfall_image_sink_f.h"
+GR_SWIG_BLOCK_MAGIC2(spectrogram, waterfall_image_sink_f);